@@ -0,0 +1,144 @@
+#ifndef ANALYSIS_CPP
+#define ANALYSIS_CPP
+
+#include "engine.cpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/*	Background analysis for the UI.
+
+	A worker thread analyses a copy of the position with Engine::analyse and writes the best lines
+	into "text". The UI thread never waits for it : it posts positions with analyse() and collects
+	the text with poll(), both of which only hold the lock for a copy. GLUT calls stay in the UI
+	thread, as GLUT is not thread-safe.
+*/
+
+#define ANALYSIS_LINES 3	 // Number of lines shown
+#define ANALYSIS_PV_MOVES 6 // Moves shown per line
+
+class Analysis
+{
+public:
+	Engine engine;
+	mutex lock;				// protects everything below
+	condition_variable wake;
+	char fen[100];			// Position to analyse
+	int generation, done;	// generation is increased for every new position or stop
+	int active;				// 0 while the worker is told to wait
+	char text[512];			// Last result, for the message box
+	int fresh;				// 1 if text has not been collected yet
+	int turn;				// Player to move in the analysed position
+	uint64_t key;			// Key of the analysed position
+	Line best;				// Best line of the last result, depth 0 if none
+	Analysis();
+	void analyse(Chessboard &c);
+	void halt();
+	int poll(char *out);
+	int result(uint64_t &k, Line &line);
+	void run();
+	static void report(const vector<Line> &lines, void *data);
+};
+
+Analysis::Analysis()
+{
+	generation = done = active = fresh = turn = 0;
+	key = 0;
+	best.depth = 0;
+	fen[0] = text[0] = '\0';
+	thread(&Analysis::run, this).detach(); // lives as long as the program
+}
+
+void Analysis::analyse(Chessboard &c) // start analysing the position on c, stopping the previous analysis
+{
+	lock_guard<mutex> guard(lock);
+	c.fen(fen);
+	active = 1;
+	generation++;
+	engine.stop = 1;
+	wake.notify_one();
+}
+
+void Analysis::halt() // stop analysing
+{
+	lock_guard<mutex> guard(lock);
+	active = 0;
+	generation++;
+	engine.stop = 1;
+}
+
+int Analysis::poll(char *out) // copy the latest analysis into out. Returns 0 if nothing changed
+{
+	lock_guard<mutex> guard(lock);
+	if (!fresh)
+		return 0;
+	strcpy(out, text);
+	fresh = 0;
+	return 1;
+}
+
+int Analysis::result(uint64_t &k, Line &line) // best line of the latest analysis and its position. Returns 0 if none
+{
+	lock_guard<mutex> guard(lock);
+	if (best.depth == 0)
+		return 0;
+	k = key;
+	line = best;
+	return 1;
+}
+
+void Analysis::run()
+{
+	Chessboard c;
+	for (;;)
+	{
+		{
+			unique_lock<mutex> guard(lock);
+			while (!active || done == generation)
+				wake.wait(guard);
+			done = generation;
+			c.setup(fen);
+			turn = c.turn;
+			key = c.key();
+			best.depth = 0;
+			engine.stop = 0; // a new position posted after this sets it again
+		}
+		engine.analyse(c, ANALYSIS_LINES, report, this);
+	}
+}
+
+void Analysis::report(const vector<Line> &lines, void *data)
+{
+	Analysis *a = (Analysis *)data;
+	char buf[512], name[5];
+	int n = 0;
+	if (lines.size() == 0)
+		n = sprintf(buf, "ANALYSIS : NO LEGAL MOVE");
+	else
+		n = sprintf(buf, "ANALYSIS DEPTH %d  (%llu NODES)", lines[0].depth, (unsigned long long)a->engine.nodes);
+	for (int i = 0; i < lines.size(); i++)
+	{
+		int s = lines[i].score;
+		const char *side[2] = {"WHITE", "BLACK"};
+		if (s > MATE - MAX_PLY)
+			n += sprintf(buf + n, "\n%d.  %s MATES IN %d ", i + 1, side[a->turn], (MATE - s + 1) / 2);
+		else if (s < -MATE + MAX_PLY)
+			n += sprintf(buf + n, "\n%d.  %s MATES IN %d ", i + 1, side[!a->turn], (MATE + s) / 2);
+		else // scores are shown for white
+			n += sprintf(buf + n, "\n%d.  %+.2f ", i + 1, (a->turn == 0 ? s : -s) / 100.0);
+		for (int j = 0; j < lines[i].pv.size() && j < ANALYSIS_PV_MOVES; j++)
+		{
+			move_name(lines[i].pv[j], name);
+			n += sprintf(buf + n, " %s", name);
+		}
+	}
+	lock_guard<mutex> guard(a->lock);
+	if (a->done != a->generation)
+		return; // the position changed while this iteration ran
+	strcpy(a->text, buf);
+	a->fresh = 1;
+	if (lines.size() != 0)
+		a->best = lines[0];
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "scheduler.cpp"
+#include "archive.cpp"
+
+/*	Engine annotation of archived games.
+
+		annotate games.cga [-depth n] [-nodes n] [-ms n] [-threads n] [-stdin]
+
+	Every position of every game is analysed as a bulk job of an AnalysisScheduler (default limit
+	depth 4) and printed as soon as it is done. Positions are read from the archive as the workers
+	need them (BULK_PER_WORKER jobs pending per worker), so memory does not grow with the archive :
+
+		game 3 ply 12 depth 4 score +0.35 best e2e4 pv e2e4 e7e5 ...
+
+	Scores are for white. With -stdin, FEN lines read from standard input while the games are
+	analysed are interactive jobs : they take a worker from the bulk jobs at once and are printed
+	with the time they waited. The tool then ends when standard input is closed and every job is done.
+*/
+
+#define BULK_PER_WORKER 2
+
+class PositionTag // What a job is about, for printing its result. Deleted with it
+{
+public:
+	int game, ply; // game -1 for a position read from standard input
+	int turn;
+	string fen;
+};
+
+mutex output;
+
+void print_result(const AnalysisResult &r, void *data)
+{
+	PositionTag *tag = (PositionTag *)data;
+	char line[1024], name[5];
+	int n;
+	if (tag->game >= 0)
+		n = sprintf(line, "game %d ply %d", tag->game, tag->ply);
+	else
+		n = sprintf(line, "position %s waited %.1f ms", tag->fen.c_str(), r.wait_ms);
+	if (r.status == ANALYSIS_INVALID)
+		n += sprintf(line + n, " invalid");
+	else
+	{
+		int s = tag->turn == 0 ? r.score : -r.score;
+		n += sprintf(line + n, " depth %d score ", r.depth);
+		if (abs(s) > MATE - MAX_PLY)
+			n += sprintf(line + n, "%s", s > 0 ? "white mates" : "black mates");
+		else
+			n += sprintf(line + n, "%+.2f", s / 100.0);
+		if (r.best.x != 9)
+		{
+			move_name(r.best, name);
+			n += sprintf(line + n, " best %s pv", name);
+			for (int i = 0; i < r.pv.size() && i < 8; i++)
+			{
+				move_name(r.pv[i], name);
+				n += sprintf(line + n, " %s", name);
+			}
+		}
+	}
+	delete tag;
+	lock_guard<mutex> guard(output);
+	cout << line << endl;
+}
+
+int main(int argc, char **argv)
+{
+	AnalysisLimits limits(4);
+	int threads = thread::hardware_concurrency(), interactive = 0, ok = argc >= 2;
+	for (int i = 2; i < argc && ok; i++)
+	{
+		string o = argv[i];
+		if (o == "-stdin")
+			interactive = 1;
+		else if (i + 1 == argc)
+			ok = 0;
+		else if (o == "-depth")
+			limits.depth = atoi(argv[++i]);
+		else if (o == "-nodes")
+			limits.nodes = atoll(argv[++i]);
+		else if (o == "-ms")
+			limits.ms = atof(argv[++i]);
+		else if (o == "-threads")
+			threads = atoi(argv[++i]);
+		else
+			ok = 0;
+	}
+	ArchiveReader in;
+	if (!ok || (limits.depth <= 0 && limits.nodes == 0 && limits.ms <= 0) || !in.open(argv[1]))
+	{
+		cerr << "usage: " << argv[0] << " games.cga [-depth n] [-nodes n] [-ms n] [-threads n] [-stdin]" << endl;
+		return 1;
+	}
+	threads = max(threads, 1);
+	AnalysisScheduler scheduler(threads);
+
+	thread reader;
+	if (interactive)
+		reader = thread([&]() {
+			string line;
+			Chessboard c;
+			while (getline(cin, line))
+			{
+				if (line.empty())
+					continue;
+				PositionTag *tag = new PositionTag;
+				tag->game = -1;
+				tag->fen = line;
+				tag->turn = c.setup(line.c_str()) ? c.turn : 0;
+				scheduler.submit(line.c_str(), 1, limits, print_result, tag);
+			}
+		});
+
+	Chessboard c;
+	vector<Move> list;
+	char fen[100];
+	for (uint64_t g = 0; g < in.size(); g++)
+	{
+		int plies, result;
+		const unsigned char *moves = in.game(g, plies, result);
+		c.newgame();
+		for (int ply = 0; moves != NULL && ply <= plies; ply++)
+		{
+			PositionTag *tag = new PositionTag;
+			tag->game = g;
+			tag->ply = ply;
+			tag->turn = c.turn;
+			c.fen(fen);
+			scheduler.wait_pending(BULK_PER_WORKER * threads);
+			scheduler.submit(fen, 0, limits, print_result, tag);
+			if (ply == plies)
+				break;
+			c.legal_moves(list);
+			if (moves[ply] >= list.size())
+				break; // corrupt game
+			c.make(list[moves[ply]]);
+		}
+	}
+	if (interactive)
+		reader.join();
+	scheduler.wait();
+	return 0;
+}
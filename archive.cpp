@@ -0,0 +1,313 @@
+#ifndef ARCHIVE_CPP
+#define ARCHIVE_CPP
+
+#include "chess.cpp"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*	Binary game archive.
+
+	A move is stored as its index in Chessboard::legal_moves() of the position it is played in, so
+	every move takes a single byte. The file is laid out as
+
+		ArchiveHeader | moves of game 0 | moves of game 1 | ... | ArchiveEntry[games]
+
+	The index at the end gives the offset of every game, so a single game can be found and replayed
+	straight from the mapped file without reading the others. New games are appended to a copy of the
+	archive, over the old index, and the index is written again after them. The copy replaces the
+	archive only when it is complete, so an interrupted write leaves the old archive as it was.
+*/
+
+#define ARCHIVE_MAGIC "CGA1"
+#define ARCHIVE_VERSION 1
+
+// Result of an archived game
+#define RESULT_UNKNOWN 0
+#define RESULT_WHITE 1
+#define RESULT_BLACK 2
+#define RESULT_DRAW 3
+
+#define MAX_GAME_PLIES 300 // Games played by the tools are drawn after this
+
+struct ArchiveHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t games;		   // Number of games in the archive
+	uint64_t index_offset; // Position of the ArchiveEntry table in the file
+};
+
+struct ArchiveEntry
+{
+	uint64_t offset; // Position of the first move of the game in the file
+	uint32_t plies;	 // Number of moves (one byte each)
+	uint32_t result;
+};
+
+class GameRecord // A game in the archive format
+{
+public:
+	vector<unsigned char> moves;
+	int result;
+	GameRecord() { result = RESULT_UNKNOWN; }
+};
+
+// Result of the game in the position reached on the Chessboard (mate or stalemate), RESULT_UNKNOWN otherwise
+int game_result(Chessboard &c)
+{
+	vector<Move> list;
+	c.legal_moves(list);
+	if (list.size() != 0)
+		return RESULT_UNKNOWN;
+	if (c.attacked(c.turn))
+		return c.turn == 0 ? RESULT_BLACK : RESULT_WHITE;
+	return RESULT_DRAW;
+}
+
+// Result of a game played by a tool in the position reached on the Chessboard, RESULT_UNKNOWN if it goes on :
+// mate, stalemate, threefold repetition, bare Kings or MAX_GAME_PLIES. keys are those of the positions
+// of the game, the current one last
+int adjudicate(Chessboard &c, const vector<uint64_t> &keys, int ply)
+{
+	int result = game_result(c);
+	if (result != RESULT_UNKNOWN)
+		return result;
+	int repeated = 0, pieces = 0;
+	for (int i = 0; i < keys.size(); i++)
+		repeated += keys[i] == keys.back();
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < Chessboard::PIECES; j++)
+			pieces += c.player[i][j] != NULL;
+	return repeated >= 3 || pieces == 2 || ply >= MAX_GAME_PLIES ? RESULT_DRAW : RESULT_UNKNOWN;
+}
+
+// Encode a list of moves played from the initial position. Returns 0 if one of the moves is illegal
+int encode_game(const vector<Move> &moves, GameRecord &rec)
+{
+	Chessboard c;
+	vector<Move> list;
+	rec.moves.clear();
+	for (int i = 0; i < moves.size(); i++)
+	{
+		c.legal_moves(list);
+		int index = -1;
+		for (int j = 0; j < list.size(); j++)
+			if (list[j].x == moves[i].x && list[j].y == moves[i].y && list[j].fx == moves[i].fx && list[j].fy == moves[i].fy)
+			{
+				index = j;
+				break;
+			}
+		if (index == -1 || index > 255)
+			return 0;
+		rec.moves.push_back(index);
+		c.play(list[index]);
+	}
+	rec.result = game_result(c);
+	return 1;
+}
+
+// Play the archived moves on a Chessboard set to the initial position. Returns 0 on a corrupt move
+int replay_game(Chessboard &c, const unsigned char *moves, int plies)
+{
+	vector<Move> list;
+	for (int i = 0; i < plies; i++)
+	{
+		c.legal_moves(list);
+		if (moves[i] >= list.size() || c.play(list[moves[i]]) == 0)
+			return 0;
+	}
+	return 1;
+}
+
+class ArchiveWriter // Appends games to an archive file, creating it if needed
+{
+public:
+	FILE *fp;	  // The copy being written
+	string path;  // The archive, replaced by the copy at close()
+	uint64_t end; // Position where the next game is written
+	int failed;	  // A write failed : close() keeps the old archive
+	vector<ArchiveEntry> index;
+	ArchiveWriter() { fp = NULL; }
+	~ArchiveWriter() { close(); }
+	int open(const char *path);
+	int add(const GameRecord &rec);
+	int close();
+};
+
+int ArchiveWriter::open(const char *file)
+// Returns 0 if the file exists but is not an archive of this version : it is never overwritten
+{
+	ArchiveHeader head;
+	index.clear();
+	path = file;
+	failed = 0;
+	end = sizeof(ArchiveHeader);
+	FILE *in = fopen(file, "rb");
+	if (in == NULL && errno != ENOENT)
+		return 0;
+	uint64_t length = 0;
+	if (in != NULL)
+	{
+		fseek(in, 0, SEEK_END);
+		length = ftell(in);
+		fseek(in, 0, SEEK_SET);
+	}
+	if (length != 0) // an empty file is a new archive
+	{
+		int ok = fread(&head, sizeof(head), 1, in) == 1 && memcmp(head.magic, ARCHIVE_MAGIC, 4) == 0 && head.version == ARCHIVE_VERSION &&
+				 head.index_offset >= sizeof(ArchiveHeader) && head.index_offset <= length &&
+				 (length - head.index_offset) / sizeof(ArchiveEntry) >= head.games;
+		if (ok)
+		{
+			index.resize(head.games);
+			fseek(in, head.index_offset, SEEK_SET);
+			ok = head.games == 0 || fread(&index[0], sizeof(ArchiveEntry), head.games, in) == head.games;
+		}
+		if (!ok)
+		{
+			fclose(in);
+			return 0;
+		}
+		end = head.index_offset; // the new games go over the old index
+	}
+	fp = fopen((path + ".tmp").c_str(), "w+b");
+	if (fp != NULL && in != NULL && length != 0)
+	{
+		// Copy the games, the offsets in the index stay the same
+		char buffer[1 << 16];
+		fseek(in, 0, SEEK_SET);
+		for (uint64_t done = 0; done < end && !failed;)
+		{
+			size_t n = min((uint64_t)sizeof(buffer), end - done);
+			if (fread(buffer, 1, n, in) != n || fwrite(buffer, 1, n, fp) != n)
+				failed = 1;
+			done += n;
+		}
+	}
+	if (in != NULL)
+		fclose(in);
+	if (fp != NULL && failed)
+	{
+		fclose(fp);
+		fp = NULL;
+		unlink((path + ".tmp").c_str());
+	}
+	return fp != NULL;
+}
+
+int ArchiveWriter::add(const GameRecord &rec)
+{
+	if (fp == NULL || failed)
+		return 0;
+	ArchiveEntry e;
+	e.offset = end;
+	e.plies = rec.moves.size();
+	e.result = rec.result;
+	fseek(fp, end, SEEK_SET);
+	if (e.plies != 0 && fwrite(&rec.moves[0], 1, e.plies, fp) != e.plies)
+	{
+		failed = 1;
+		return 0;
+	}
+	end += e.plies;
+	index.push_back(e);
+	return 1;
+}
+
+int ArchiveWriter::close() // write the index and the header, and replace the archive. The new games are only in it after this
+{
+	if (fp == NULL)
+		return 0;
+	ArchiveHeader head;
+	memcpy(head.magic, ARCHIVE_MAGIC, 4);
+	head.version = ARCHIVE_VERSION;
+	head.games = index.size();
+	head.index_offset = end = (end + 7) & ~(uint64_t)7; // Keep the index aligned for the mapped reader
+	int ok = !failed;
+	fseek(fp, end, SEEK_SET);
+	if (index.size() != 0 && fwrite(&index[0], sizeof(ArchiveEntry), index.size(), fp) != index.size())
+		ok = 0;
+	fseek(fp, 0, SEEK_SET);
+	if (fwrite(&head, sizeof(head), 1, fp) != 1 || fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+		ok = 0;
+	if (fclose(fp) != 0)
+		ok = 0;
+	fp = NULL;
+	string temp = path + ".tmp";
+	if (!ok || rename(temp.c_str(), path.c_str()) != 0)
+	{
+		unlink(temp.c_str());
+		return 0;
+	}
+	return 1;
+}
+
+class ArchiveReader // Read-only access to an archive mapped in memory
+{
+public:
+	const unsigned char *data;
+	size_t length;
+	const ArchiveHeader *head;
+	const ArchiveEntry *index;
+	ArchiveReader() { data = NULL; }
+	~ArchiveReader() { close(); }
+	int open(const char *path);
+	void close();
+	uint64_t size() { return data == NULL ? 0 : head->games; }
+	// Moves of game i. Returns NULL if the game does not exist
+	const unsigned char *game(uint64_t i, int &plies, int &result);
+};
+
+int ArchiveReader::open(const char *path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(ArchiveHeader))
+	{
+		::close(fd);
+		return 0;
+	}
+	void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // The mapping stays valid after the file is closed
+	if (p == MAP_FAILED)
+		return 0;
+	data = (const unsigned char *)p;
+	length = st.st_size;
+	head = (const ArchiveHeader *)data;
+	if (memcmp(head->magic, ARCHIVE_MAGIC, 4) != 0 || head->version != ARCHIVE_VERSION ||
+		head->index_offset > length || (length - head->index_offset) / sizeof(ArchiveEntry) < head->games)
+	{
+		close();
+		return 0;
+	}
+	index = (const ArchiveEntry *)(data + head->index_offset);
+	return 1;
+}
+
+void ArchiveReader::close()
+{
+	if (data != NULL)
+		munmap((void *)data, length);
+	data = NULL;
+}
+
+const unsigned char *ArchiveReader::game(uint64_t i, int &plies, int &result)
+{
+	if (i >= size() || index[i].offset + index[i].plies > length)
+		return NULL;
+	plies = index[i].plies;
+	result = index[i].result;
+	return data + index[i].offset;
+}
+
+#endif
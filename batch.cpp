@@ -0,0 +1,279 @@
+#ifndef BATCH_CPP
+#define BATCH_CPP
+
+#include "chess.cpp"
+
+/*	Attack sets, check flags and legal move counts of many positions at once.
+
+	A PositionBatch holds BATCH positions as bitboards (bit x * 8 + y is the square (x, y)) in
+	structure-of-arrays layout : pieces[color][kind] is a vector with one bitboard per position.
+	The batch functions work on all the positions together with GCC vector extensions and are
+	compiled twice (target_clones) : with AVX2, picked at run time when the processor has it, and
+	for plain x86-64. Sliding Pieces use Kogge-Stone fills, so no square is visited in a loop.
+
+	The rules are those of Chessboard::legal : no castling or en passant, a Pawn moves two squares
+	only from its starting rank, and a move is legal if its King is not attacked afterwards. Legal
+	moves are counted by listing the moves of each position, then testing the i-th move of every
+	position at once.
+*/
+
+#define BATCH 8			// Positions per batch
+#define BATCH_MOVES 320 // More than the moves of any position, legal or not
+
+typedef uint64_t lanes __attribute__((vector_size(8 * BATCH)));
+
+// Squares a step may land on : a step to a higher y must not land on y = 0, and to a lower y on y = 7
+#define ALL_SQUARES 0xFFFFFFFFFFFFFFFFULL
+#define NOT_Y0 0xFEFEFEFEFEFEFEFEULL
+#define NOT_Y7 0x7F7F7F7F7F7F7F7FULL
+#define NOT_Y01 0xFCFCFCFCFCFCFCFCULL
+#define NOT_Y67 0x3F3F3F3F3F3F3F3FULL
+
+#define BATCH_INLINE static inline __attribute__((always_inline))
+
+template <int S, class T>
+BATCH_INLINE T shift(T b) // move every bit S places up (down if S < 0)
+{
+	if constexpr (S > 0)
+		return b << S;
+	else
+		return b >> -S;
+}
+
+template <int S, uint64_t M, class T>
+BATCH_INLINE T step(T b) // one step of S (8 is x + 1, 1 is y + 1) landing on the squares M
+{
+	return shift<S>(b) & M;
+}
+
+template <int S, uint64_t M, class T>
+BATCH_INLINE T slide(T from, T empty) // squares reached from "from" by steps of S, up to the first occupied one
+{
+	empty &= M;
+	from |= empty & shift<S>(from);
+	empty &= shift<S>(empty);
+	from |= empty & shift<2 * S>(from);
+	empty &= shift<2 * S>(empty);
+	from |= empty & shift<4 * S>(from);
+	return step<S, M>(from);
+}
+
+template <class T>
+BATCH_INLINE T rook_attacks(T from, T empty)
+{
+	return slide<1, NOT_Y0>(from, empty) | slide<-1, NOT_Y7>(from, empty) | slide<8, ALL_SQUARES>(from, empty) | slide<-8, ALL_SQUARES>(from, empty);
+}
+
+template <class T>
+BATCH_INLINE T bishop_attacks(T from, T empty)
+{
+	return slide<9, NOT_Y0>(from, empty) | slide<-7, NOT_Y0>(from, empty) | slide<7, NOT_Y7>(from, empty) | slide<-9, NOT_Y7>(from, empty);
+}
+
+template <class T>
+BATCH_INLINE T knight_attacks(T b)
+{
+	return step<10, NOT_Y01>(b) | step<-6, NOT_Y01>(b) | step<6, NOT_Y67>(b) | step<-10, NOT_Y67>(b) |
+		   step<17, NOT_Y0>(b) | step<-15, NOT_Y0>(b) | step<15, NOT_Y7>(b) | step<-17, NOT_Y7>(b);
+}
+
+template <class T>
+BATCH_INLINE T king_attacks(T b)
+{
+	return step<1, NOT_Y0>(b) | step<-1, NOT_Y7>(b) | step<8, ALL_SQUARES>(b) | step<-8, ALL_SQUARES>(b) |
+		   step<9, NOT_Y0>(b) | step<-7, NOT_Y0>(b) | step<7, NOT_Y7>(b) | step<-9, NOT_Y7>(b);
+}
+
+template <class T>
+BATCH_INLINE T pawn_attacks(T b, T white) // white has all bits set where the Pawns are white
+{
+	return (white & (step<9, NOT_Y0>(b) | step<-7, NOT_Y0>(b))) | (~white & (step<7, NOT_Y7>(b) | step<-9, NOT_Y7>(b)));
+}
+
+template <class T>
+BATCH_INLINE T attacked(T king, const T enemy[6], T empty, T white)
+// squares of "king" attacked by the Pieces "enemy" of the other player. white has all bits set where
+// the King is white. Attacks are traced back from the King, so a single square is filled
+{
+	return (pawn_attacks(king, white) & enemy[5]) | (knight_attacks(king) & enemy[4]) | (king_attacks(king) & enemy[0]) |
+		   (rook_attacks(king, empty) & (enemy[1] | enemy[2])) | (bishop_attacks(king, empty) & (enemy[1] | enemy[3]));
+}
+
+class PositionBatch
+{
+public:
+	lanes pieces[2][6]; // [color][kind] (see kind())
+	lanes black;		// All bits set in the lanes where black is to move
+	int size;			// Positions loaded, the other lanes are empty
+	PositionBatch();
+	void clear();
+	void load(int lane, Chessboard &c);
+	int load(int lane, const PackedBoard &b);
+};
+
+PositionBatch::PositionBatch()
+{
+	clear();
+}
+
+void PositionBatch::clear()
+{
+	memset((void *)this, 0, sizeof(*this));
+}
+
+void PositionBatch::load(int lane, Chessboard &c) // copy the position on c into a lane
+{
+	for (int i = 0; i < 2; i++)
+		for (int k = 0; k < 6; k++)
+			pieces[i][k][lane] = 0;
+	for (int x = 0; x < 8; x++)
+		for (int y = 0; y < 8; y++)
+			if (c.board[x][y] != NULL)
+				pieces[c.board[x][y]->color][kind(c.board[x][y])][lane] |= 1ULL << (x * 8 + y);
+	black[lane] = c.turn ? ALL_SQUARES : 0;
+	if (lane >= size)
+		size = lane + 1;
+}
+
+int PositionBatch::load(int lane, const PackedBoard &b) // copy a packed position into a lane. Returns 0 if it is invalid
+{
+	for (int i = 0; i < 2; i++)
+		for (int k = 0; k < 6; k++)
+			pieces[i][k][lane] = 0;
+	black[lane] = 0;
+	int n = 0;
+	for (int i = 0; i < 64; i++)
+	{
+		if (!((b.occupied >> i) & 1))
+			continue;
+		if (n == 32)
+			return 0;
+		int v = (b.pieces[n / 2] >> (n % 2 * 4)) & 15, color = v / 8, k = v % 8;
+		n++;
+		if (k > 6)
+			return 0;
+		if (k == 6) // King of the player to move
+		{
+			black[lane] = color ? ALL_SQUARES : 0;
+			k = 0;
+		}
+		pieces[color][k][lane] |= 1ULL << i;
+	}
+	if (lane >= size)
+		size = lane + 1;
+	return 1;
+}
+
+// Pieces of the player to move (mine) and of the other one (theirs) in every lane
+BATCH_INLINE void sides(const PositionBatch &b, lanes mine[6], lanes theirs[6])
+{
+	for (int k = 0; k < 6; k++)
+	{
+		mine[k] = (b.pieces[0][k] & ~b.black) | (b.pieces[1][k] & b.black);
+		theirs[k] = (b.pieces[1][k] & ~b.black) | (b.pieces[0][k] & b.black);
+	}
+}
+
+__attribute__((target_clones("avx2", "default"))) void batch_attacks(const PositionBatch &b, lanes attacks[2])
+// squares attacked by the Pieces of each player (white, black) in every lane
+{
+	lanes occupied = {};
+	for (int i = 0; i < 2; i++)
+		for (int k = 0; k < 6; k++)
+			occupied |= b.pieces[i][k];
+	lanes empty = ~occupied, white = ~(occupied & 0);
+	for (int i = 0; i < 2; i++, white = ~white)
+	{
+		const lanes *p = b.pieces[i];
+		attacks[i] = pawn_attacks(p[5], white) | knight_attacks(p[4]) | king_attacks(p[0]) |
+					 rook_attacks(p[1] | p[2], empty) | bishop_attacks(p[1] | p[3], empty);
+	}
+}
+
+__attribute__((target_clones("avx2", "default"))) void batch_in_check(const PositionBatch &b, int check[BATCH])
+// 1 in the lanes where the player to move is in check
+{
+	lanes mine[6], theirs[6], occupied = {};
+	sides(b, mine, theirs);
+	for (int k = 0; k < 6; k++)
+		occupied |= mine[k] | theirs[k];
+	lanes hit = attacked(mine[0], theirs, ~occupied, ~b.black);
+	for (int i = 0; i < BATCH; i++)
+		check[i] = i < b.size && hit[i] != 0;
+}
+
+static int batch_moves(const PositionBatch &b, int lane, uint64_t from[], uint64_t to[])
+// moves of the player to move in a lane, legal or not. Returns their number
+{
+	int color = b.black[lane] != 0, n = 0;
+	uint64_t mine = 0, theirs = 0;
+	for (int k = 0; k < 6; k++)
+	{
+		mine |= b.pieces[color][k][lane];
+		theirs |= b.pieces[!color][k][lane];
+	}
+	uint64_t empty = ~(mine | theirs), white = color ? 0 : ALL_SQUARES;
+	for (int k = 0; k < 6; k++)
+		for (uint64_t set = b.pieces[color][k][lane]; set != 0; set &= set - 1)
+		{
+			uint64_t sq = set & -set, t;
+			if (k == 0)
+				t = king_attacks(sq) & ~mine;
+			else if (k == 4)
+				t = knight_attacks(sq) & ~mine;
+			else if (k == 5)
+			{
+				uint64_t push = (color ? step<-1, NOT_Y7>(sq) : step<1, NOT_Y0>(sq)) & empty;
+				if (sq & (color ? 0x4040404040404040ULL : 0x0202020202020202ULL)) // starting rank
+					push |= (color ? step<-1, NOT_Y7>(push) : step<1, NOT_Y0>(push)) & empty;
+				t = push | (pawn_attacks(sq, white) & theirs);
+			}
+			else
+				t = ((k != 3 ? rook_attacks(sq, empty) : 0) | (k != 2 ? bishop_attacks(sq, empty) : 0)) & ~mine;
+			for (; t != 0; t &= t - 1)
+			{
+				from[n] = sq;
+				to[n++] = t & -t;
+			}
+		}
+	return n;
+}
+
+__attribute__((target_clones("avx2", "default"))) void batch_count(const PositionBatch &b, int count[BATCH])
+// number of legal moves in every lane
+{
+	static thread_local uint64_t from[BATCH][BATCH_MOVES], to[BATCH][BATCH_MOVES];
+	int n[BATCH], most = 0;
+	for (int i = 0; i < BATCH; i++)
+	{
+		n[i] = i < b.size ? batch_moves(b, i, from[i], to[i]) : 0;
+		most = max(most, n[i]);
+		count[i] = 0;
+	}
+	lanes mine[6], theirs[6], occupied = {}, white = ~b.black;
+	sides(b, mine, theirs);
+	for (int k = 0; k < 6; k++)
+		occupied |= mine[k] | theirs[k];
+
+	for (int j = 0; j < most; j++)
+	{
+		// the j-th move of every lane, nothing in the lanes that have fewer moves
+		lanes f, t;
+		for (int i = 0; i < BATCH; i++)
+		{
+			f[i] = j < n[i] ? from[i][j] : 0;
+			t[i] = j < n[i] ? to[i][j] : 0;
+		}
+		// comparisons give all bits set in the lanes where they are true
+		lanes king = (mine[0] & ~f) | (t & (lanes)((mine[0] & f) != 0)), after[6];
+		king &= (lanes)(f != 0); // lanes without a move are never counted
+		for (int k = 0; k < 6; k++)
+			after[k] = theirs[k] & ~t; // a captured Piece does not attack
+		lanes hit = attacked(king, after, ~((occupied & ~f) | t), white);
+		lanes legal = (lanes)(hit == 0) & (lanes)(king != 0);
+		for (int i = 0; i < BATCH; i++)
+			count[i] += legal[i] != 0;
+	}
+}
+
+#endif
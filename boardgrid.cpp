@@ -0,0 +1,340 @@
+#ifndef BOARDGRID_CPP
+#define BOARDGRID_CPP
+
+#include <GL/gl.h>
+#include <math.h>
+#include <string.h>
+#include <limits.h>
+#include "chess.cpp"
+#include "archive.cpp"
+
+/*	Many boards in one window, drawn in batches.
+
+	A BoardGrid lays out its boards in the grid of columns and rows that gives them the largest
+	squares in the window, and is laid out again when the window is resized. Every board is drawn
+	with filled triangles only (the shapes of main.cpp, as fractions of a square), written to one
+	vertex array with their colours and drawn with a single glDrawArrays call. Fixed-function GL
+	has no instancing, so this is the batch : one call per frame whatever the number of boards.
+
+	The grid keeps the BoardState it last drew for every board. update() marks a board dirty only
+	when its new state differs, and draw() redraws the dirty boards alone, each over its own cell,
+	so the window is drawn in a single buffer (as in main.cpp) and a frame where one game moved
+	costs one board. redraw_all() is for exposure and resizing. draw() takes a number of boards,
+	so that the caller can keep a frame within its time : the other dirty boards wait for the next
+	frames, taken in turn. Software GL spends about a microsecond per triangle besides the pixels,
+	so every pixel of a board is filled once under its pieces, and discs get fewer triangles when
+	the squares are small.
+*/
+
+#define GRID_GAP 6			  // Pixels between two boards, for their frames
+#define GRID_DISC_SEGMENTS 12 // Triangles per disc
+
+class BoardState // What a board of the grid shows
+{
+public:
+	uint8_t squares[Chessboard::WIDTH][Chessboard::HEIGHT]; // 0 if empty, else 1 + kind + 8 * color
+	int8_t from[2], to[2];									// Last move, -1 if none
+	uint8_t result;											// RESULT_UNKNOWN while the game goes on
+	BoardState();
+	void set(Chessboard &c, const Move *last, int r);
+	int operator==(const BoardState &s) const { return memcmp(this, &s, sizeof(s)) == 0; }
+};
+
+BoardState::BoardState()
+{
+	memset(this, 0, sizeof(*this));
+	from[0] = from[1] = to[0] = to[1] = -1;
+}
+
+void BoardState::set(Chessboard &c, const Move *last, int r) // the position of c after the move "last" (NULL if none)
+{
+	for (int x = 0; x < Chessboard::WIDTH; x++)
+		for (int y = 0; y < Chessboard::HEIGHT; y++)
+			squares[x][y] = c.board[x][y] == NULL ? 0 : 1 + kind(c.board[x][y]) + 8 * c.board[x][y]->color;
+	from[0] = last ? last->x : -1;
+	from[1] = last ? last->y : -1;
+	to[0] = last ? last->fx : -1;
+	to[1] = last ? last->fy : -1;
+	result = r;
+}
+
+struct GridVertex // 12 bytes
+{
+	GLfloat x, y;
+	GLubyte r, g, b, a;
+};
+
+#define SHAPE_END 0
+#define SHAPE_RECT 1 // Corners (a, b) and (c, d)
+#define SHAPE_DISC 2 // Center (a, b), radius c
+#define SHAPE_TRI 3	 // Vertices (a, b), (c, d), (e, f)
+#define SHAPE_LINE 4 // From (a, b) to (c, d)
+
+struct Shape // Part of a piece, in squares from the center of its square
+{
+	int type;
+	float a = 0, b = 0, c = 0, d = 0, e = 0, f = 0; // unused ones are 0
+};
+
+// The pieces of main.cpp, in the order of kind() : King, Queen, Rook, Bishop, Knight, Pawn.
+// Its circles are points of size r, so their radius is r / 2
+const Shape piece_shapes[6][10] = {
+	{{SHAPE_RECT, -1 / 14.285f, 1 / 2.702f, 1 / 14.285f, 1 / 3.125f},
+	 {SHAPE_RECT, -1 / 33.33f, 1 / 2.439f, 1 / 50.f, 1 / 3.33f},
+	 {SHAPE_DISC, 0, 1 / 5.f, 1 / 11.11f},
+	 {SHAPE_RECT, -1 / 25.f, 1 / 10.f, 1 / 25.f, 1 / 20.f},
+	 {SHAPE_RECT, -1 / 11.11f, 1 / 20.f, 1 / 11.11f, 0},
+	 {SHAPE_RECT, -1 / 16.667f, 0, 1 / 16.667f, -1 / 4.167f},
+	 {SHAPE_RECT, -1 / 11.11f, -1 / 4.167f, 1 / 11.11f, -1 / 3.448f},
+	 {SHAPE_RECT, -1 / 9.09f, -1 / 3.448f, 1 / 9.09f, -1 / 2.564f}},
+	{{SHAPE_TRI, -1 / 25.f, 1 / 2.778f, 1 / 25.f, 1 / 2.778f, 0, 1 / 2.439f},
+	 {SHAPE_RECT, -1 / 11.11f, 1 / 2.778f, 1 / 11.11f, 1 / 3.333f},
+	 {SHAPE_DISC, 0, 1 / 5.f, 1 / 11.11f},
+	 {SHAPE_RECT, -1 / 25.f, 1 / 10.f, 1 / 25.f, 1 / 20.f},
+	 {SHAPE_RECT, -1 / 11.11f, 1 / 20.f, 1 / 11.11f, 0},
+	 {SHAPE_RECT, -1 / 16.667f, 0, 1 / 16.667f, -1 / 4.166f},
+	 {SHAPE_RECT, -1 / 11.11f, -1 / 4.167f, 1 / 11.111f, -1 / 3.448f},
+	 {SHAPE_RECT, -1 / 9.09f, -1 / 3.448f, 1 / 9.09f, -1 / 2.564f}},
+	{{SHAPE_RECT, -1 / 8.333f, 1 / 5.f, 1 / 8.333f, 1 / 20.f},
+	 {SHAPE_RECT, -1 / 11.11f, 1 / 20.f, 1 / 11.11f, -1 / 3.448f},
+	 {SHAPE_RECT, -1 / 11.11f, -1 / 4.167f, 1 / 11.11f, -1 / 3.448f},
+	 {SHAPE_RECT, -1 / 9.09f, -1 / 3.448f, 1 / 9.09f, -1 / 2.564f}},
+	{{SHAPE_DISC, 0, 1 / 3.33f, 1 / 15.384f},
+	 {SHAPE_DISC, 0, 1 / 6.667f, 1 / 11.11f},
+	 {SHAPE_RECT, -1 / 25.f, 1 / 20.f, 1 / 25.f, -1 / 50.f},
+	 {SHAPE_RECT, -1 / 11.11f, -1 / 50.f, 1 / 11.11f, -1 / 14.285f},
+	 {SHAPE_RECT, -1 / 16.667f, -1 / 14.285f, 1 / 16.667f, -1 / 4.167f},
+	 {SHAPE_RECT, -1 / 11.11f, -1 / 4.167f, 1 / 11.11f, -1 / 3.448f},
+	 {SHAPE_RECT, -1 / 9.09f, -1 / 3.448f, 1 / 9.09f, -1 / 2.564f}},
+	{{SHAPE_LINE, 0, 1 / 4.347f, -1 / 9.09f, 1 / 5.f},
+	 {SHAPE_LINE, -1 / 9.09f, 1 / 5.f, -1 / 14.285f, -1 / 14.285f},
+	 {SHAPE_LINE, 0, 1 / 4.3478f, 1 / 4.f, 1 / 14.285f},
+	 {SHAPE_LINE, 1 / 4.f, 1 / 14.285f, 1 / 5.f, 0},
+	 {SHAPE_LINE, 1 / 5.f, 0, 1 / 12.5f, 1 / 25.f},
+	 {SHAPE_LINE, 1 / 12.5f, 1 / 25.f, 1 / 16.667f, -1 / 14.285f},
+	 {SHAPE_RECT, -1 / 16.667f, -1 / 14.285f, 1 / 16.667f, -1 / 4.167f},
+	 {SHAPE_RECT, -1 / 11.11f, -1 / 4.167f, 1 / 11.11f, -1 / 3.448f},
+	 {SHAPE_RECT, -1 / 9.09f, -1 / 3.448f, 1 / 9.09f, -1 / 2.564f}},
+	{{SHAPE_DISC, 0, 1 / 20.f, 1 / 10.f},
+	 {SHAPE_RECT, -1 / 16.667f, -1 / 14.285f, 1 / 16.667f, -1 / 4.167f},
+	 {SHAPE_RECT, -1 / 11.11f, -1 / 4.167f, 1 / 11.11f, -1 / 3.448f},
+	 {SHAPE_RECT, -1 / 9.09f, -1 / 3.448f, 1 / 9.09f, -1 / 2.564f}}};
+
+class BoardGrid
+{
+public:
+	int count;			 // Boards
+	int width, height;	 // Window
+	int cols, rows, d;	 // Grid, and size of a square in pixels
+	int left, bottom;	 // Corner of the grid, which is centered
+	vector<BoardState> shown; // State of every board, drawn or to draw
+	vector<char> dirty;
+	int next;					 // Board draw() looks at first
+	vector<GridVertex> vertices; // Batch of the current frame
+	GLubyte colour[4];			 // Of the triangles being added
+	BoardGrid(int n);
+	void layout(int w, int h);
+	void update(int board, const BoardState &s);
+	void redraw_all();
+	int draw(int limit = INT_MAX);
+	void add_board(int board);
+	void set_colour(int r, int g, int b);
+	void quad(float x0, float y0, float x1, float y1);
+	void triangle(float x0, float y0, float x1, float y1, float x2, float y2);
+	void disc(float x, float y, float r);
+	void line(float x0, float y0, float x1, float y1, float width);
+	void piece(float x, float y, int p);
+};
+
+BoardGrid::BoardGrid(int n)
+{
+	count = n;
+	shown.resize(n);
+	dirty.assign(n, 1);
+	width = height = 0;
+	cols = rows = 1;
+	d = 1;
+	left = bottom = 0;
+	next = 0;
+}
+
+void BoardGrid::layout(int w, int h) // choose the grid for a window of w x h pixels, and redraw everything
+{
+	width = w;
+	height = h;
+	cols = rows = 1;
+	d = 0;
+	for (int c = 1; c <= count; c++)
+	{
+		int r = (count + c - 1) / c;
+		int size = min((w - GRID_GAP * (c + 1)) / (c * Chessboard::WIDTH), (h - GRID_GAP * (r + 1)) / (r * Chessboard::HEIGHT));
+		if (size > d)
+		{
+			d = size;
+			cols = c;
+			rows = r;
+		}
+	}
+	if (d < 1) // the boards do not fit, they will overlap
+	{
+		d = 1;
+		cols = (int)ceil(sqrt((double)count));
+		rows = (count + cols - 1) / cols;
+	}
+	left = (w - cols * (d * Chessboard::WIDTH + GRID_GAP) + GRID_GAP) / 2;
+	bottom = (h - rows * (d * Chessboard::HEIGHT + GRID_GAP) + GRID_GAP) / 2;
+	redraw_all();
+}
+
+void BoardGrid::update(int board, const BoardState &s) // show s on a board from the next draw(), if it changed
+{
+	if (shown[board] == s)
+		return;
+	shown[board] = s;
+	dirty[board] = 1;
+}
+
+void BoardGrid::redraw_all() // the window was cleared : the next draw() draws every board
+{
+	dirty.assign(count, 1);
+}
+
+int BoardGrid::draw(int limit) // draw at most limit dirty boards in one call. Returns how many were drawn
+{
+	vertices.clear();
+	int drawn = 0;
+	for (int n = 0; n < count && drawn < limit; n++, next = (next + 1) % count)
+		if (dirty[next])
+		{
+			add_board(next);
+			dirty[next] = 0;
+			drawn++;
+		}
+	if (vertices.size() == 0)
+		return 0;
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(GridVertex), &vertices[0].x);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(GridVertex), &vertices[0].r);
+	glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	return drawn;
+}
+
+void BoardGrid::set_colour(int r, int g, int b)
+{
+	colour[0] = r;
+	colour[1] = g;
+	colour[2] = b;
+	colour[3] = 255;
+}
+
+void BoardGrid::triangle(float x0, float y0, float x1, float y1, float x2, float y2)
+{
+	GridVertex v[3] = {{x0, y0, colour[0], colour[1], colour[2], colour[3]},
+					   {x1, y1, colour[0], colour[1], colour[2], colour[3]},
+					   {x2, y2, colour[0], colour[1], colour[2], colour[3]}};
+	for (int i = 0; i < 3; i++)
+		vertices.push_back(v[i]);
+}
+
+void BoardGrid::quad(float x0, float y0, float x1, float y1)
+{
+	triangle(x0, y0, x1, y0, x1, y1);
+	triangle(x0, y0, x1, y1, x0, y1);
+}
+
+void BoardGrid::disc(float x, float y, float r)
+{
+	static float unit[GRID_DISC_SEGMENTS + 1][2]; // points of the unit circle
+	if (unit[1][0] == 0)
+		for (int i = 0; i <= GRID_DISC_SEGMENTS; i++)
+		{
+			unit[i][0] = cos(2 * M_PI * i / GRID_DISC_SEGMENTS);
+			unit[i][1] = sin(2 * M_PI * i / GRID_DISC_SEGMENTS);
+		}
+	int step = r < 3 ? 3 : r < 6 ? 2 : 1; // 4, 6 or 12 triangles
+	for (int i = 0; i < GRID_DISC_SEGMENTS; i += step)
+		triangle(x, y, x + r * unit[i][0], y + r * unit[i][1], x + r * unit[i + step][0], y + r * unit[i + step][1]);
+}
+
+void BoardGrid::line(float x0, float y0, float x1, float y1, float width) // as a quad, width in pixels
+{
+	float dx = x1 - x0, dy = y1 - y0, l = sqrt(dx * dx + dy * dy);
+	if (l == 0)
+		return;
+	float nx = -dy / l * width / 2, ny = dx / l * width / 2;
+	triangle(x0 + nx, y0 + ny, x1 + nx, y1 + ny, x1 - nx, y1 - ny);
+	triangle(x0 + nx, y0 + ny, x1 - nx, y1 - ny, x0 - nx, y0 - ny);
+}
+
+void BoardGrid::piece(float x, float y, int p) // the piece p (as in BoardState::squares) centered on (x, y)
+{
+	if (p >= 9)
+		set_colour(30, 5, 34); // black
+	else
+		set_colour(57, 94, 144); // white
+	float width = max(1.0f, d / 40.0f);
+	for (const Shape *s = piece_shapes[(p - 1) % 8]; s->type != SHAPE_END; s++)
+		if (s->type == SHAPE_RECT)
+			quad(x + s->a * d, y + s->b * d, x + s->c * d, y + s->d * d);
+		else if (s->type == SHAPE_DISC)
+			disc(x + s->a * d, y + s->b * d, s->c * d);
+		else if (s->type == SHAPE_TRI)
+			triangle(x + s->a * d, y + s->b * d, x + s->c * d, y + s->d * d, x + s->e * d, y + s->f * d);
+		else
+			line(x + s->a * d, y + s->b * d, x + s->c * d, y + s->d * d, width);
+}
+
+void BoardGrid::add_board(int board) // the triangles of a board, covering its whole cell once (software GL is bound by the pixels filled)
+{
+	const BoardState &s = shown[board];
+	int size = d * Chessboard::WIDTH, cell = d * Chessboard::HEIGHT, f = GRID_GAP / 2;
+	float x0 = left + board % cols * (size + GRID_GAP), y0 = bottom + (rows - 1 - board / cols) * (cell + GRID_GAP);
+
+	// squares, the last move marked by a border
+	float mark = max(1, d / 12);
+	for (int x = 0; x < Chessboard::WIDTH; x++)
+		for (int y = 0; y < Chessboard::HEIGHT; y++)
+		{
+			float sx = x0 + x * d, sy = y0 + y * d, in = 0;
+			if ((x == s.from[0] && y == s.from[1]) || (x == s.to[0] && y == s.to[1]))
+			{
+				set_colour(30, 144, 255);
+				quad(sx, sy, sx + d, sy + d);
+				in = mark;
+			}
+			if ((x + y) % 2 == 0)
+				set_colour(195, 127, 10);
+			else
+				set_colour(255, 255, 255);
+			quad(sx + in, sy + in, sx + d - in, sy + d - in);
+		}
+
+	// lines between the squares, as skeleton_box draws them, when they leave room for the squares
+	set_colour(155, 77, 19);
+	for (int i = 1; i < Chessboard::WIDTH && d >= 8; i++)
+		quad(x0 + i * d - 0.5f, y0, x0 + i * d + 0.5f, y0 + cell);
+	for (int i = 1; i < Chessboard::HEIGHT && d >= 8; i++)
+		quad(x0, y0 + i * d - 0.5f, x0 + size, y0 + i * d + 0.5f);
+
+	// the frame : brown while the game goes on, then the colour of the winner, grey for a draw
+	if (s.result == RESULT_WHITE)
+		set_colour(57, 94, 144);
+	else if (s.result == RESULT_BLACK)
+		set_colour(30, 5, 34);
+	else if (s.result == RESULT_DRAW)
+		set_colour(128, 128, 128);
+	quad(x0 - f, y0 - f, x0 + size + f, y0);
+	quad(x0 - f, y0 + cell, x0 + size + f, y0 + cell + f);
+	quad(x0 - f, y0, x0, y0 + cell);
+	quad(x0 + size, y0, x0 + size + f, y0 + cell);
+
+	for (int x = 0; x < Chessboard::WIDTH; x++)
+		for (int y = 0; y < Chessboard::HEIGHT; y++)
+			if (s.squares[x][y] != 0)
+				piece(x0 + x * d + d / 2.0f, y0 + y * d + d / 2.0f, s.squares[x][y]);
+}
+
+#endif
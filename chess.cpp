@@ -1,10 +1,26 @@
+#ifndef CHESS_CPP
+#define CHESS_CPP
+
 #include <iostream>
 #include <math.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <vector>
+#include <algorithm>
+#include <type_traits>
 using namespace std;
 
-class Piece;
+#include "stats.cpp"
+
+/*	The board size is a template parameter : BasicChessboard<W, H> is a board of W columns and H rows,
+	compiled for that size only. Chessboard (and Piece, UndoObj...) are the 8x8 board used by the UI,
+	the engine and the tools; other sizes get their own instantiation, like Chessboard10x8 below.
+	A set of squares is a 64-bit integer when the board fits, a 128-bit one otherwise.
+*/
+
+template <int W, int H>
+class BasicPiece;
 
 class Pair // Class used to represent a position on the Chessboard
 {
@@ -36,18 +52,29 @@ public:
 	}
 };
 
-class UndoObj // Format used when bacKing up a move for undo operation
+class Move // A move of the Piece at (x, y) to (fx, fy)
 {
 public:
 	int x, y;	// Initial position
 	int fx, fy; // Final position
-	Piece *loc; // Pointer to the Piece being moved
-	UndoObj(Piece *temp, int a, int b, int c, int d) : loc(temp), x(a), y(b), fx(c), fy(d) {}
+	Move(int a = 0, int b = 0, int c = 0, int d = 0) : x(a), y(b), fx(c), fy(d) {}
 };
 
-class Piece // Base class containing data common to all chess Pieces
+template <int W, int H>
+class BasicUndoObj // Format used when bacKing up a move for undo operation
 {
 public:
+	int x, y;	// Initial position
+	int fx, fy; // Final position
+	BasicPiece<W, H> *loc; // Pointer to the Piece being moved
+	BasicUndoObj(BasicPiece<W, H> *temp, int a, int b, int c, int d) : loc(temp), x(a), y(b), fx(c), fy(d) {}
+};
+
+template <int W, int H>
+class BasicPiece // Base class containing data common to all chess Pieces
+{
+public:
+	typedef BasicPiece Piece;
 	int x, y, points, color;			   // 1=>white, 2=>black  // 0->white, 1->black
 	int dir, org_x, org_y, has_been_moved; // dir->direction
 	void (*disp)(int, int, int);
@@ -57,7 +84,7 @@ public:
 	   It returns the Path that the Piece will take in moving from (x, y) --> (fx, fy).
 	*/
 
-	virtual Path checkmove(int, int, Piece *[8][8]);
+	virtual Path checkmove(int, int, Piece *[W][H]);
 
 	// Used to clear the Piece in the UI
 	void clear();
@@ -69,15 +96,16 @@ public:
 	void display();
 
 	// Constructor for the Piece class
-	Piece(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int));
+	BasicPiece(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int));
 
 	// Function to move the Piece from (x, y) to (fx, fy)
-	Piece *move(int fx, int fy, Piece *[8][8]);
+	Piece *move(int fx, int fy, Piece *[W][H]);
 
-	virtual ~Piece() {}
+	virtual ~BasicPiece() {}
 };
 
-Piece::Piece(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int))
+template <int W, int H>
+BasicPiece<W, H>::BasicPiece(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int))
 {
 	x = org_x = ix;
 	y = org_y = iy;
@@ -92,7 +120,8 @@ Piece::Piece(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int),
 		disp(x, y, color);
 }
 
-Piece *Piece::move(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+BasicPiece<W, H> *BasicPiece<W, H>::move(int fx, int fy, Piece *board[W][H])
 {
 	Piece *ret = board[fx][fy];
 
@@ -104,7 +133,7 @@ Piece *Piece::move(int fx, int fy, Piece *board[8][8])
 	if (!(x == fx && y == fy))
 		board[x][y] = NULL; // Clear the Piece in the chess 2D array
 
-	(*clearbox)(x, y);
+	clear();
 
 	board[fx][fy]->x = fx;
 	board[fx][fy]->y = fy;
@@ -114,24 +143,28 @@ Piece *Piece::move(int fx, int fy, Piece *board[8][8])
 	return ret;
 }
 
-void Piece::clear()
+template <int W, int H>
+void BasicPiece<W, H>::clear()
 {
 	if (clearbox != NULL)
 		(*clearbox)(x, y);
 }
 
-void Piece::display()
+template <int W, int H>
+void BasicPiece<W, H>::display()
 {
 	if (disp != NULL)
 		(*disp)(x, y, color);
 }
 
-Path Piece::checkmove(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+Path BasicPiece<W, H>::checkmove(int fx, int fy, Piece *board[W][H])
 {
+	STAT_INC(STAT_CHECKMOVE);
 	Path ret0, ret;	 // ret0 corresponds to an empty Path, ret corresponds to a non-empty Path
 	ret.build(x, y); // Build the Path starting from the current position
 
-	if (fx >= 8 || fx < 0 || fy >= 8 || fy < 0)
+	if (fx >= W || fx < 0 || fy >= H || fy < 0)
 		return ret0; // Return an empty Path if the destination is out of bounds
 
 	if (fx == x && fy == y)
@@ -148,15 +181,20 @@ Path Piece::checkmove(int fx, int fy, Piece *board[8][8])
 	return ret;
 }
 
-class Rook : virtual public Piece
+template <int W, int H>
+class BasicRook : virtual public BasicPiece<W, H>
 {
 public:
-	Rook(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
-	Path checkmove(int, int, Piece *[8][8]);
-	~Rook() {}
+	typedef BasicPiece<W, H> Piece;
+	using Piece::x;
+	using Piece::y;
+	BasicRook(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
+	Path checkmove(int, int, Piece *[W][H]);
+	~BasicRook() {}
 };
 
-Path Rook::checkmove(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+Path BasicRook<W, H>::checkmove(int fx, int fy, Piece *board[W][H])
 {
 	Path ret0, ret = Piece::checkmove(fx, fy, board);
 	if (ret.status == 0)
@@ -187,15 +225,20 @@ Path Rook::checkmove(int fx, int fy, Piece *board[8][8])
 	return ret;
 }
 
-class Bishop : virtual public Piece
+template <int W, int H>
+class BasicBishop : virtual public BasicPiece<W, H>
 {
 public:
-	Bishop(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
-	Path checkmove(int, int, Piece *[8][8]);
-	~Bishop() {}
+	typedef BasicPiece<W, H> Piece;
+	using Piece::x;
+	using Piece::y;
+	BasicBishop(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
+	Path checkmove(int, int, Piece *[W][H]);
+	~BasicBishop() {}
 };
 
-Path Bishop::checkmove(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+Path BasicBishop<W, H>::checkmove(int fx, int fy, Piece *board[W][H])
 {
 	Path ret0, ret = Piece::checkmove(fx, fy, board);
 	if (ret.status == 0)
@@ -226,15 +269,20 @@ Path Bishop::checkmove(int fx, int fy, Piece *board[8][8])
 	return ret;
 }
 
-class Queen : public Rook, public Bishop
+template <int W, int H>
+class BasicQueen : public BasicRook<W, H>, public BasicBishop<W, H>
 {
 public:
-	Queen(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Rook(ix, iy, p, c, d, displ, clearb), Bishop(ix, iy, p, c, d, displ, clearb), Piece(ix, iy, p, c, d, displ, clearb) {}
-	Path checkmove(int, int, Piece *[8][8]);
-	~Queen() {}
+	typedef BasicPiece<W, H> Piece;
+	typedef BasicRook<W, H> Rook;
+	typedef BasicBishop<W, H> Bishop;
+	BasicQueen(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Rook(ix, iy, p, c, d, displ, clearb), Bishop(ix, iy, p, c, d, displ, clearb), Piece(ix, iy, p, c, d, displ, clearb) {}
+	Path checkmove(int, int, Piece *[W][H]);
+	~BasicQueen() {}
 };
 
-Path Queen::checkmove(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+Path BasicQueen<W, H>::checkmove(int fx, int fy, Piece *board[W][H])
 {
 	/*Queen can move like a Rook and a Bishop.So checKing if move is legal wrt Bishop or Rook
 	if legal, the Path obtained is returned as the final Path*/
@@ -245,14 +293,19 @@ Path Queen::checkmove(int fx, int fy, Piece *board[8][8])
 	else
 		return ret2;
 }
-class Knight : virtual public Piece
+template <int W, int H>
+class BasicKnight : virtual public BasicPiece<W, H>
 {
 public:
-	Knight(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
-	Path checkmove(int, int, Piece *[8][8]);
+	typedef BasicPiece<W, H> Piece;
+	using Piece::x;
+	using Piece::y;
+	BasicKnight(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
+	Path checkmove(int, int, Piece *[W][H]);
 };
 
-Path Knight::checkmove(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+Path BasicKnight<W, H>::checkmove(int fx, int fy, Piece *board[W][H])
 {
 	// Knight can move in total 8 possible postions. All are checked. Path consists of only one position
 	int pos[8][2] = {{x - 1, y + 2}, {x - 2, y + 1}, {x + 1, y + 2}, {x + 2, y + 1}, {x - 1, y - 2}, {x - 2, y - 1}, {x + 1, y - 2}, {x + 2, y - 1}};
@@ -267,15 +320,24 @@ Path Knight::checkmove(int fx, int fy, Piece *board[8][8])
 	return ret0;
 }
 
-class Pawn : public Piece
+template <int W, int H>
+class BasicPawn : public BasicPiece<W, H>
 {
 public:
-	Pawn(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
-	Path checkmove(int, int, Piece *[8][8]);
-	void check_promo(int, int, Piece *[8][8]);
+	typedef BasicPiece<W, H> Piece;
+	using Piece::x;
+	using Piece::y;
+	using Piece::color;
+	using Piece::dir;
+	using Piece::org_x;
+	using Piece::org_y;
+	BasicPawn(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
+	Path checkmove(int, int, Piece *[W][H]);
+	void check_promo(int, int, Piece *[W][H]);
 };
 
-Path Pawn::checkmove(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+Path BasicPawn<W, H>::checkmove(int fx, int fy, Piece *board[W][H])
 {
 	/*Pawn can perform capture diagonally and move forward wrt it's side.Double move is allowed if the Pawn
 	is moving for the first time */
@@ -301,14 +363,19 @@ Path Pawn::checkmove(int fx, int fy, Piece *board[8][8])
 	return ret0;
 }
 
-class King : public Piece
+template <int W, int H>
+class BasicKing : public BasicPiece<W, H>
 {
 public:
-	King(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
-	Path checkmove(int, int, Piece *[8][8]);
+	typedef BasicPiece<W, H> Piece;
+	using Piece::x;
+	using Piece::y;
+	BasicKing(int ix, int iy, int p, int c, int d, void (*displ)(int, int, int), void (*clearb)(int, int)) : Piece(ix, iy, p, c, d, displ, clearb) {}
+	Path checkmove(int, int, Piece *[W][H]);
 };
 
-Path King::checkmove(int fx, int fy, Piece *board[8][8])
+template <int W, int H>
+Path BasicKing<W, H>::checkmove(int fx, int fy, Piece *board[W][H])
 {
 	// King can move within a radius of one chess box
 	Path ret0, ret = Piece::checkmove(fx, fy, board);
@@ -321,18 +388,113 @@ Path King::checkmove(int fx, int fy, Piece *board[8][8])
 	return ret0;
 }
 
-class Chessboard
+// Index of a Piece in tables indexed by kind of Piece, found from its points
+// King = 0, Queen = 1, Rook = 2, Bishop = 3, Knight = 4, Pawn = 5
+template <int W, int H>
+int kind(BasicPiece<W, H> *p)
+{
+	switch (p->points)
+	{
+	case 99:
+		return 0;
+	case 5:
+		return 1;
+	case 2:
+		return 2;
+	case 4:
+		return 3;
+	case 3:
+		return 4;
+	default:
+		return 5;
+	}
+}
+
+template <int W, int H>
+class BasicZobrist // Random numbers used to hash a position
 {
 public:
+	uint64_t piece[2][6][W][H]; // [color][kind][x][y]
+	uint64_t black;				// Added when black is to move
+	BasicZobrist();
+	static const BasicZobrist &table(); // The numbers of the board size, created on first use
+};
+
+template <int W, int H>
+BasicZobrist<W, H>::BasicZobrist()
+{
+	// Fixed seed (splitmix64), so that keys stored in files stay valid between runs
+	uint64_t s = 0x9E3779B97F4A7C15ULL;
+	uint64_t *t = &piece[0][0][0][0];
+	for (int i = 0; i <= 2 * 6 * W * H; i++)
+	{
+		uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		z ^= z >> 31;
+		if (i < 2 * 6 * W * H)
+			t[i] = z;
+		else
+			black = z;
+	}
+}
+
+template <int W, int H>
+const BasicZobrist<W, H> &BasicZobrist<W, H>::table()
+{
+	static const BasicZobrist t;
+	return t;
+}
+
+template <int W, int H>
+struct BasicPackedBoard // A position in 24 bytes for 8x8
+{
+	typename conditional<(W * H <= 64), uint64_t, unsigned __int128>::type occupied; // bit (x * H + y) is set if a Piece stands on (x, y)
+	uint8_t pieces[2 * W]; // one nibble per Piece, in the order of the occupied bits : color * 8 + kind.
+						   // The King of the player to move is stored with kind 6, which gives the turn
+};
+
+// Empty UI callbacks, used when the chess engine runs without a window
+void no_box(int, int) {}
+void no_display() {}
+void no_message(char *) {}
+
+template <int W, int H>
+class BasicChessboard
+{
+	static_assert(W >= 8 && H >= 4 && W * H <= 128, "unsupported board size");
+
+public:
+	typedef BasicPiece<W, H> Piece;
+	typedef BasicKing<W, H> King;
+	typedef BasicQueen<W, H> Queen;
+	typedef BasicRook<W, H> Rook;
+	typedef BasicBishop<W, H> Bishop;
+	typedef BasicKnight<W, H> Knight;
+	typedef BasicPawn<W, H> Pawn;
+	typedef BasicUndoObj<W, H> UndoObj;
+	typedef BasicPackedBoard<W, H> PackedBoard;
+	typedef typename conditional<(W * H <= 64), uint64_t, unsigned __int128>::type Squares; // bit (x * H + y) for (x, y)
+	static const int WIDTH = W, HEIGHT = H;
+	static const int PIECES = 2 * W;				  // Size of a player's collection of Pieces
+	static const int NONE = (W > H ? W : H) + 1; // prev_x and prev_y when no Piece is selected
+
 	int prev_x, prev_y, select_p, turn;
 	vector<UndoObj> prev_list;
-	Piece *player[2][16];
-	Piece *board[8][8];
-	Chessboard(void (*skeleton_b)(int, int), void (*clearb)(int, int), void (*highlightb)(int, int), void (*disp)(), void (*msg)(char *));
+	Piece *player[2][PIECES];
+	Piece *board[W][H];
+	Squares targets[W][H]; // Legal destinations of each Piece of the player to move
+	uint64_t pawn_key;	   // Zobrist key of the Pawns alone, kept up to date by every move
+	int targets_valid;	   // 0 after any change of the position, until targets is computed again
+	Squares marked; // Destinations shown for the selected Piece
+	BasicChessboard(void (*skeleton_b)(int, int), void (*clearb)(int, int), void (*highlightb)(int, int), void (*disp)(), void (*msg)(char *), void (*markb)(int, int) = NULL);
+	BasicChessboard(); // Headless Chessboard in the initial position, with no UI attached
+	~BasicChessboard();
 	void select(int, int);
 	void (*skeleton_box)(int, int);
 	void (*clearbox)(int, int);
 	void (*highlight)(int, int);
+	void (*mark)(int, int); // Shows a legal destination of the selected Piece
 	void setKing(void (*displ)(int, int, int));
 	void setQueen(void (*displ)(int, int, int));
 	void setBishop(void (*displ)(int, int, int));
@@ -358,24 +520,54 @@ public:
 	void check_promo(int, int);
 	void remove(Piece *);
 	void add_Piece(Piece *);
+	int attacked(int);
+	int legal(int, int, int, int);
+	void legal_moves(vector<Move> &);
+	int play(Move);
+	void make(Move);
+	void unmake();
+	void game_moves(vector<Move> &);
+	void clear_pieces();
+	void newgame();
+	void update_targets();
+	int can_move(int, int, int, int);
+	void unmark();
+	uint64_t key();
+	uint64_t pawn_hash();
+	void toggle_pawn(Piece *, int, int);
+	Piece *create(char, int, int);
+	int place(Piece *, int[2], int[2]);
+	void pack(PackedBoard &);
+	int unpack(const PackedBoard &);
+	int setup(const char *);
+	void fen(char *);
+
+private:
+	BasicChessboard(const BasicChessboard &); // Pieces are owned by the Chessboard, so it cannot be copied
+	BasicChessboard &operator=(const BasicChessboard &);
 };
 
-void Chessboard::undo_move() // move is reversed completely. Invoked for undoing a move on user request.
+template <int W, int H>
+void BasicChessboard<W, H>::undo_move() // move is reversed completely. Invoked for undoing a move on user request.
 {
 	if (prev_list.size() == 0)
 		return;
 	undo(); // undoing move in the chess engine.
+	unmark();
 	skeleton_box(prev_x, prev_y);
 	display();
-	prev_x = prev_y = 9;
+	prev_x = prev_y = NONE;
 	select_p = 0;
 	turn = !turn; // changing turn;
 }
 
-void Chessboard::undo() // move is reversed without changing the turn.Used by the chess engine.
+template <int W, int H>
+void BasicChessboard<W, H>::undo() // move is reversed without changing the turn.Used by the chess engine.
 {
 	if (prev_list.size() == 0)
 		return;
+	STAT_INC(STAT_UNDO);
+	targets_valid = 0;
 	UndoObj temp = prev_list.back();
 	if (temp.x == temp.fx && temp.y == temp.fy)
 	{
@@ -383,14 +575,18 @@ void Chessboard::undo() // move is reversed without changing the turn.Used by th
 		delete board[temp.fx][temp.fy];
 		board[temp.fx][temp.fy] = temp.loc;
 		add_Piece(temp.loc);
+		toggle_pawn(temp.loc, temp.fx, temp.fy);
 		prev_list.pop_back();
 		temp = prev_list.back();
 	}
+	toggle_pawn(board[temp.fx][temp.fy], temp.fx, temp.fy);
+	toggle_pawn(board[temp.fx][temp.fy], temp.x, temp.y);
 	board[temp.fx][temp.fy]->move(temp.x, temp.y, board);
 	board[temp.fx][temp.fy] = temp.loc;
 	if (temp.loc != NULL)
 	{
-		for (int i = 0; i < 16; i++)
+		toggle_pawn(temp.loc, temp.fx, temp.fy);
+		for (int i = 0; i < PIECES; i++)
 			if (player[(temp.loc)->color][i] == NULL)
 			{
 				player[(temp.loc)->color][i] = temp.loc;
@@ -401,22 +597,27 @@ void Chessboard::undo() // move is reversed without changing the turn.Used by th
 	prev_list.pop_back();
 }
 
-void Chessboard::add_Piece(Piece *p) // add Piece to player's collection of active Pieces on the chess board
+template <int W, int H>
+void BasicChessboard<W, H>::add_Piece(Piece *p) // add Piece to player's collection of active Pieces on the chess board
 {
-	for (int i = 0; i < 16; i++)
+	for (int i = 0; i < PIECES; i++)
 		if (player[p->color][i] == NULL)
+		{
 			player[p->color][i] = p;
+			break;
+		}
 }
 
-void Chessboard::check_promo(int fx, int fy) // check for Pawn promotion
+template <int W, int H>
+void BasicChessboard<W, H>::check_promo(int fx, int fy) // check for Pawn promotion
 {
-	if (board[fx][fy]->points == 1 && ((turn == 0 && fy == 7) || (turn == 1 && fy == 0)))
+	if (board[fx][fy]->points == 1 && ((turn == 0 && fy == H - 1) || (turn == 1 && fy == 0)))
 	{
-		cout << "CHECK PROMO" << endl;
 		int temp1 = prev_x, temp2 = prev_y;
 		prev_x = fx;
 		prev_y = fy;
 		remove_Piece(board[fx][fy], fx, fy);
+		toggle_pawn(board[fx][fy], fx, fy);
 		prev_x = temp1;
 		prev_y = temp2;
 		board[fx][fy] = new Queen(fx, fy, 5, turn, turn == 0 ? 1 : -1, dQueen, clearbox);
@@ -426,16 +627,18 @@ void Chessboard::check_promo(int fx, int fy) // check for Pawn promotion
 	}
 }
 
-void Chessboard::show_list()
+template <int W, int H>
+void BasicChessboard<W, H>::show_list()
 {
 	UndoObj temp = prev_list.back();
 }
 
-void Chessboard::remove(Piece *val) // remove Piece from player's collection of active Pieces on the chess board
+template <int W, int H>
+void BasicChessboard<W, H>::remove(Piece *val) // remove Piece from player's collection of active Pieces on the chess board
 {
 	if (val != NULL)
 		for (int i = 0; i < 2; i++)
-			for (int j = 0; j < 16; j++)
+			for (int j = 0; j < PIECES; j++)
 				if (player[i][j] == val)
 				{
 					player[i][j] = NULL;
@@ -443,27 +646,32 @@ void Chessboard::remove(Piece *val) // remove Piece from player's collection of
 				}
 }
 
-void Chessboard::remove_Piece(Piece *val, int fx, int fy)
+template <int W, int H>
+void BasicChessboard<W, H>::remove_Piece(Piece *val, int fx, int fy)
 {
 	UndoObj temp(val, prev_x, prev_y, fx, fy);
 	remove(val);
 
 	prev_list.push_back(temp);
+	STAT_MAX(STAT_UNDO_DEPTH, prev_list.size());
 }
 
 // Display all Pieces in the board in their respective positions
-void Chessboard::redisplay()
+template <int W, int H>
+void BasicChessboard<W, H>::redisplay()
 {
-	for (int i = 0; i < 8; i++)
-		for (int j = 0; j < 8; j++)
+	STAT_TIMER(TIMER_REDISPLAY);
+	for (int i = 0; i < W; i++)
+		for (int j = 0; j < H; j++)
 			if (board[i][j] != 0)
 				board[i][j]->display();
 }
 
-Chessboard::Chessboard(void (*skeleton_b)(int, int), void (*clearb)(int, int), void (*highlightb)(int, int), void (*disp)(), void (*msg)(char *))
+template <int W, int H>
+BasicChessboard<W, H>::BasicChessboard(void (*skeleton_b)(int, int), void (*clearb)(int, int), void (*highlightb)(int, int), void (*disp)(), void (*msg)(char *), void (*markb)(int, int))
 {
 	for (int i = 0; i < 2; i++)
-		for (int j = 0; j < 16; j++)
+		for (int j = 0; j < PIECES; j++)
 			player[i][j] = NULL;
 	skeleton_box = skeleton_b;
 	clearbox = clearb;
@@ -472,23 +680,442 @@ Chessboard::Chessboard(void (*skeleton_b)(int, int), void (*clearb)(int, int), v
 	select_p = 0;
 	turn = 0;
 	highlight = highlightb;
-	for (int i = 0; i < 8; i++)
-		for (int j = 0; j < 8; j++)
+	mark = markb;
+	targets_valid = 0;
+	marked = 0;
+	pawn_key = 0;
+	for (int i = 0; i < W; i++)
+		for (int j = 0; j < H; j++)
 			board[i][j] = NULL;
-	prev_x = prev_y = 9;
+	prev_x = prev_y = NONE;
+	dKing = dQueen = dBishop = dRook = dKnight = dPawn = NULL;
+}
+
+template <int W, int H>
+BasicChessboard<W, H>::BasicChessboard() : BasicChessboard(no_box, NULL, NULL, no_display, no_message)
+{
+	newgame();
+}
+
+template <int W, int H>
+BasicChessboard<W, H>::~BasicChessboard()
+{
+	clear_pieces();
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::clear_pieces() // delete every Piece owned by the Chessboard, on the board or captured
+{
+	for (int i = 0; i < W; i++)
+		for (int j = 0; j < H; j++)
+			if (board[i][j] != NULL)
+			{
+				delete board[i][j];
+				board[i][j] = NULL;
+			}
+	// Captured and promoted Pieces are only referenced by the undo list
+	for (int i = 0; i < prev_list.size(); i++)
+		if (prev_list[i].loc != NULL)
+			delete prev_list[i].loc;
+	prev_list.clear();
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < PIECES; j++)
+			player[i][j] = NULL;
+	pawn_key = 0;
+	targets_valid = 0; // and so for newgame(), setup() and unpack()
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::newgame() // set up the initial position again, using the display functions given earlier
+{
+	clear_pieces();
+	turn = 0;
+	select_p = 0;
+	prev_x = prev_y = NONE;
+	setKing(dKing);
+	setQueen(dQueen);
+	setBishop(dBishop);
+	setRook(dRook);
+	setKnight(dKnight);
+	setPawn(dPawn);
+	pawn_key = pawn_hash();
+}
+
+template <int W, int H>
+int BasicChessboard<W, H>::attacked(int turnt) // returns 1 if the King of "turnt" player is under check. Unlike check() nothing is displayed
+{
+	STAT_INC(STAT_ATTACKED);
+	if (player[turnt][0] == NULL)
+		return 0;
+	for (int i = 0; i < PIECES; i++)
+		if (player[!turnt][i] != NULL && player[!turnt][i]->checkmove(player[turnt][0]->x, player[turnt][0]->y, board).status == 1)
+			return 1;
+	return 0;
+}
+
+template <int W, int H>
+int BasicChessboard<W, H>::legal(int x, int y, int fx, int fy)
+// returns 1 if the Piece at (x, y) can legally move to (fx, fy). The move is tried on the 2D array only,
+// so neither the UI nor the undo list is touched
+{
+	Piece *p = board[x][y];
+	if (p == NULL || p->checkmove(fx, fy, board).status == 0)
+		return 0;
+	Piece *cap = board[fx][fy];
+	int slot = -1;
+	if (cap != NULL)
+		for (int i = 0; i < PIECES; i++)
+			if (player[cap->color][i] == cap)
+			{
+				player[cap->color][i] = NULL;
+				slot = i;
+				break;
+			}
+	board[fx][fy] = p;
+	board[x][y] = NULL;
+	p->x = fx;
+	p->y = fy;
+
+	int ret = !attacked(p->color); // move should be declared invalid if move results in check to own King
+
+	p->x = x;
+	p->y = y;
+	board[x][y] = p;
+	board[fx][fy] = cap;
+	if (slot != -1)
+		player[cap->color][slot] = cap;
+	return ret;
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::legal_moves(vector<Move> &list)
+// all legal moves of the player to move. The order only depends on the position (squares are scanned
+// column by column), so an index into the list identifies a move
+{
+	list.clear();
+	for (int x = 0; x < W; x++)
+		for (int y = 0; y < H; y++)
+			if (board[x][y] != NULL && board[x][y]->color == turn)
+				for (int fx = 0; fx < W; fx++)
+					for (int fy = 0; fy < H; fy++)
+						if (legal(x, y, fx, fy))
+							list.push_back(Move(x, y, fx, fy));
+}
+
+template <int W, int H>
+int BasicChessboard<W, H>::play(Move m) // perform a complete move (engine, undo list and UI) and change the turn
+{
+	if (board[m.x][m.y] == NULL || board[m.x][m.y]->color != turn)
+		return 0;
+	prev_x = m.x;
+	prev_y = m.y;
+	int ret = move(m.fx, m.fy);
+	if (ret)
+		turn = !turn;
+	prev_x = prev_y = NONE;
+	select_p = 0;
+	return ret;
+}
+
+template <int W, int H>
+uint64_t BasicChessboard<W, H>::key() // Zobrist key of the position: Pieces and the player to move
+{
+	const BasicZobrist<W, H> &zobrist = BasicZobrist<W, H>::table();
+	uint64_t ret = turn ? zobrist.black : 0;
+	for (int i = 0; i < W; i++)
+		for (int j = 0; j < H; j++)
+			if (board[i][j] != NULL)
+				ret ^= zobrist.piece[board[i][j]->color][kind(board[i][j])][i][j];
+	return ret;
+}
+
+template <int W, int H>
+uint64_t BasicChessboard<W, H>::pawn_hash() // Zobrist key of the Pawns, computed from the board
+{
+	const BasicZobrist<W, H> &zobrist = BasicZobrist<W, H>::table();
+	uint64_t ret = 0;
+	for (int i = 0; i < W; i++)
+		for (int j = 0; j < H; j++)
+			if (board[i][j] != NULL && board[i][j]->points == 1)
+				ret ^= zobrist.piece[board[i][j]->color][5][i][j];
+	return ret;
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::toggle_pawn(Piece *p, int x, int y) // add or remove p at (x, y) in pawn_key if it is a Pawn
+{
+	if (p != NULL && p->points == 1)
+		pawn_key ^= BasicZobrist<W, H>::table().piece[p->color][5][x][y];
+}
+
+template <int W, int H>
+BasicPiece<W, H> *BasicChessboard<W, H>::create(char c, int x, int y)
+// create the Piece written as c in FEN (uppercase for white) at (x, y). Returns NULL for an unknown letter
+{
+	int color = (c >= 'a' && c <= 'z') ? 1 : 0;
+	int d = color == 0 ? 1 : -1;
+	switch (c | 32) // lowercase
+	{
+	case 'k':
+		return new King(x, y, 99, color, d, dKing, clearbox);
+	case 'q':
+		return new Queen(x, y, 5, color, d, dQueen, clearbox);
+	case 'r':
+		return new Rook(x, y, 2, color, d, dRook, clearbox);
+	case 'b':
+		return new Bishop(x, y, 4, color, d, dBishop, clearbox);
+	case 'n':
+		return new Knight(x, y, 3, color, d, dKnight, clearbox);
+	case 'p':
+	{
+		Piece *p = new Pawn(x, y, 1, color, d, dPawn, clearbox);
+		p->org_y = color == 0 ? 1 : H - 2; // double move only from the starting rank
+		return p;
+	}
+	}
+	return NULL;
+}
+
+template <int W, int H>
+int BasicChessboard<W, H>::place(Piece *p, int count[2], int kings[2])
+// put a Piece created while setting up a position on the board and in its player's collection.
+// count and kings keep track of the Pieces placed so far. Returns 0 (and deletes p) if it does not fit
+{
+	int ok = 1;
+	if (p == NULL)
+		return 0;
+	if (p->points == 99) // the King is always the first Piece of a player
+	{
+		if (kings[p->color]++)
+			ok = 0;
+		else
+			player[p->color][0] = p;
+	}
+	else if (count[p->color] == PIECES)
+		ok = 0;
+	else
+		player[p->color][count[p->color]++] = p;
+	if (ok)
+		board[p->x][p->y] = p;
+	else
+		delete p;
+	return ok;
 }
 
-Path Chessboard::check(int turnt) // Used to check if the King has been given a check
+template <int W, int H>
+int BasicChessboard<W, H>::setup(const char *fen)
+// set up the position given in FEN (placement and player to move). The undo list is cleared.
+// Returns 0 if the FEN cannot be used by the engine (each player needs one King and at most PIECES Pieces)
+{
+	clear_pieces();
+	select_p = 0;
+	prev_x = prev_y = NONE;
+	int x = 0, y = H - 1, count[2] = {1, 1}, kings[2] = {0, 0}, ok = 1;
+	for (; ok && *fen != '\0' && *fen != ' '; fen++)
+	{
+		if (*fen == '/')
+		{
+			x = 0;
+			y--;
+		}
+		else if (*fen >= '1' && *fen <= '9')
+		{
+			char *end;
+			x += strtol(fen, &end, 10); // may have several digits on wide boards
+			fen = end - 1;
+		}
+		else
+		{
+			ok = place((x >= W || y < 0) ? NULL : create(*fen, x, y), count, kings);
+			x++;
+		}
+	}
+	while (*fen == ' ')
+		fen++;
+	turn = *fen == 'b' ? 1 : 0;
+	if (!ok || kings[0] != 1 || kings[1] != 1 || y != 0 || (*fen != 'w' && *fen != 'b'))
+	{
+		newgame();
+		return 0;
+	}
+	pawn_key = pawn_hash();
+	return 1;
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::pack(PackedBoard &b)
+{
+	memset(&b, 0, sizeof(b));
+	int n = 0;
+	for (int i = 0; i < W * H; i++)
+	{
+		Piece *p = board[i / H][i % H];
+		if (p == NULL)
+			continue;
+		int k = kind(p);
+		if (k == 0 && p->color == turn)
+			k = 6;
+		b.occupied |= (Squares)1 << i;
+		b.pieces[n / 2] |= (p->color * 8 + k) << (n % 2 * 4);
+		n++;
+	}
+}
+
+template <int W, int H>
+int BasicChessboard<W, H>::unpack(const PackedBoard &b) // set up a packed position, like setup() does for FEN
+{
+	const char letters[] = "kqrbnpk";
+	clear_pieces();
+	select_p = 0;
+	prev_x = prev_y = NONE;
+	turn = 0;
+	int count[2] = {1, 1}, kings[2] = {0, 0}, ok = 1, n = 0;
+	for (int i = 0; ok && i < W * H; i++)
+	{
+		if (!((b.occupied >> i) & 1))
+			continue;
+		if (n == 2 * PIECES)
+		{
+			ok = 0;
+			break;
+		}
+		int v = (b.pieces[n / 2] >> (n % 2 * 4)) & 15, color = v / 8, k = v % 8;
+		n++;
+		if (k > 6)
+		{
+			ok = 0;
+			break;
+		}
+		if (k == 6)
+			turn = color;
+		ok = place(create(color ? letters[k] : letters[k] - 32, i / H, i % H), count, kings);
+	}
+	if (!ok || kings[0] != 1 || kings[1] != 1)
+	{
+		newgame();
+		return 0;
+	}
+	pawn_key = pawn_hash();
+	return 1;
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::fen(char *out) // write the position in FEN. out must hold at least (W + 1) * H + 12 characters
+{
+	const char letters[] = "kqrbnp";
+	for (int y = H - 1; y >= 0; y--)
+	{
+		int empty = 0;
+		for (int x = 0; x < W; x++)
+		{
+			if (board[x][y] == NULL)
+			{
+				empty++;
+				continue;
+			}
+			if (empty)
+				out += sprintf(out, "%d", empty);
+			empty = 0;
+			char c = letters[kind(board[x][y])];
+			*out++ = board[x][y]->color == 0 ? c - 32 : c;
+		}
+		if (empty)
+			out += sprintf(out, "%d", empty);
+		if (y)
+			*out++ = '/';
+	}
+	strcpy(out, turn ? " b - - 0 1" : " w - - 0 1");
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::make(Move m)
+// quiet version of play() used by the search : the move must be legal. Check and checkmate are not
+// tested and no message is shown, but the move is backed up and Pawn promotion is done as usual
+{
+	prev_x = m.x;
+	prev_y = m.y;
+	STAT_INC(STAT_MOVE);
+	targets_valid = 0;
+	toggle_pawn(board[m.x][m.y], m.x, m.y);
+	toggle_pawn(board[m.x][m.y], m.fx, m.fy);
+	toggle_pawn(board[m.fx][m.fy], m.fx, m.fy);
+	Piece *tt = board[m.x][m.y]->move(m.fx, m.fy, board);
+	remove_Piece(tt, m.fx, m.fy);
+	check_promo(m.fx, m.fy);
+	prev_x = prev_y = NONE;
+	turn = !turn;
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::unmake() // reverse the last move made by make()
+{
+	turn = !turn;
+	undo();
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::update_targets() // compute the legal destinations of every Piece, once per position
+{
+	if (targets_valid)
+		return;
+	vector<Move> list;
+	legal_moves(list);
+	memset(targets, 0, sizeof(targets));
+	for (int i = 0; i < list.size(); i++)
+		targets[list[i].x][list[i].y] |= (Squares)1 << (list[i].fx * H + list[i].fy);
+	targets_valid = 1;
+}
+
+template <int W, int H>
+int BasicChessboard<W, H>::can_move(int x, int y, int fx, int fy) // 1 if the move is legal for the player to move
+{
+	if (fx < 0 || fx >= W || fy < 0 || fy >= H)
+		return 0;
+	update_targets();
+	return (targets[x][y] >> (fx * H + fy)) & 1;
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::unmark() // remove the destinations shown for the selected Piece
+{
+	if (mark == NULL)
+		return;
+	for (int i = 0; i < W * H; i++)
+		if ((marked >> i) & 1)
+		{
+			clearbox(i / H, i % H);
+			if (board[i / H][i % H] != NULL)
+				board[i / H][i % H]->display();
+		}
+	marked = 0;
+}
+
+template <int W, int H>
+void BasicChessboard<W, H>::game_moves(vector<Move> &list) // moves played so far, recovered from the undo list
+{
+	list.clear();
+	for (int i = 0; i < prev_list.size(); i++)
+	{
+		UndoObj temp = prev_list[i];
+		if (temp.x == temp.fx && temp.y == temp.fy)
+			continue; // Pawn promotion, not a move of its own
+		list.push_back(Move(temp.x, temp.y, temp.fx, temp.fy));
+	}
+}
+
+template <int W, int H>
+Path BasicChessboard<W, H>::check(int turnt) // Used to check if the King has been given a check
 {
 	// Note : only 2 players are there. If turn = 0, then !turn = 1
 	/*	This is evaluated by checKing if any Piece of "(!turn)" player can move to the position in which
 		the King of the "turn" player is present. If such a move is possible. A check for "turn" player is
 		declared. Path of the check is returned
 	*/
+	STAT_INC(STAT_CHECK);
 	Path ret0, ret;
 	if (player[turnt][0] != NULL)
 	{
-		for (int i = 0; i < 16; i++)
+		for (int i = 0; i < PIECES; i++)
 		{
 			if (player[!turnt][i] != NULL)
 			{
@@ -505,7 +1132,8 @@ Path Chessboard::check(int turnt) // Used to check if the King has been given a
 	return ret0;
 }
 
-int Chessboard::move(int x, int y) // used to perform the move in the chess engine,backup move,display message
+template <int W, int H>
+int BasicChessboard<W, H>::move(int x, int y) // used to perform the move in the chess engine,backup move,display message
 {
 	Path ret;
 	if (prev_x == x && prev_y == y)
@@ -513,6 +1141,11 @@ int Chessboard::move(int x, int y) // used to perform the move in the chess engi
 	ret = board[prev_x][prev_y]->checkmove(x, y, board);
 	if (ret.status)
 	{
+		STAT_INC(STAT_MOVE);
+		targets_valid = 0;
+		toggle_pawn(board[prev_x][prev_y], prev_x, prev_y);
+		toggle_pawn(board[prev_x][prev_y], x, y);
+		toggle_pawn(board[x][y], x, y);
 		Piece *tt = board[prev_x][prev_y]->move(x, y, board);
 		remove_Piece(tt, x, y);
 		// move should be declared invalid if move results in check to own King
@@ -548,7 +1181,8 @@ int Chessboard::move(int x, int y) // used to perform the move in the chess engi
 	return 1;
 }
 
-int Chessboard::checkmate(int turnt, Path ret) // used to check if a checkmate has occured for "turnt" player
+template <int W, int H>
+int BasicChessboard<W, H>::checkmate(int turnt, Path ret) // used to check if a checkmate has occured for "turnt" player
 {
 	/*
 		Checkmate is declared if 3 conditions are fullfilled.
@@ -573,15 +1207,18 @@ int Chessboard::checkmate(int turnt, Path ret) // used to check if a checkmate h
 	// checKing the first condition in the below code
 	int King_move[8][2] = {{x + 1, y}, {x + 1, y + 1}, {x, y + 1}, {x - 1, y + 1}, {x - 1, y}, {x - 1, y - 1}, {x, y - 1}, {x + 1, y - 1}};
 	for (int i = 0; i < 8; i++)
+	{
+		STAT_INC(STAT_CHECKMATE_TRIAL);
 		if (move(King_move[i][0], King_move[i][1]) == 1)
 		{
 			undo();
 			turn = temp_turn;
 			return 0;
 		}
+	}
 
 	// ChecKing second and third conditions in the below code
-	for (int i = 1; i < 16; i++)
+	for (int i = 1; i < PIECES; i++)
 	{
 		if (player[turnt][i] == NULL)
 			continue;
@@ -591,6 +1228,7 @@ int Chessboard::checkmate(int turnt, Path ret) // used to check if a checkmate h
 			Pair pos = ret.route.at(j);
 			prev_x = player[turnt][i]->x;
 			prev_y = player[turnt][i]->y;
+			STAT_INC(STAT_CHECKMATE_TRIAL);
 			if (move(pos.x, pos.y) == 1)
 			{
 				undo();
@@ -605,9 +1243,11 @@ int Chessboard::checkmate(int turnt, Path ret) // used to check if a checkmate h
 	return 1;
 }
 
-void Chessboard::select(int x, int y)
+template <int W, int H>
+void BasicChessboard<W, H>::select(int x, int y)
 // input from the UI is fed here. invokes move function and flushes the changes made in the chess engine to the UI
 {
+	STAT_TIMER(TIMER_SELECT);
 	if (select_p == 0)
 	{
 		if (prev_x == x && prev_y == y || board[x][y] == NULL)
@@ -617,6 +1257,14 @@ void Chessboard::select(int x, int y)
 		if (highlight != NULL)
 		{
 			highlight(x, y);
+			if (mark != NULL) // show where the Piece can go
+			{
+				update_targets();
+				marked = targets[x][y];
+				for (int i = 0; i < W * H; i++)
+					if ((marked >> i) & 1)
+						mark(i / H, i % H);
+			}
 			display();
 		}
 		prev_x = x;
@@ -627,78 +1275,113 @@ void Chessboard::select(int x, int y)
 	}
 	else if (select_p == 1)
 	{
-		if (prev_x == 9 || prev_y == 9)
+		if (prev_x == NONE || prev_y == NONE)
 			return;
-		if (move(x, y) == 0)
+		// legal moves are known for the turn, so illegal moves are rejected without being tried
+		if (!can_move(prev_x, prev_y, x, y))
 		{
-			char p[] = "INVALID MOVE!! ";
-			message(p);
+			if (!(prev_x == x && prev_y == y) && board[prev_x][prev_y]->checkmove(x, y, board).status)
+			{
+				char p[] = "SELF CHECK!!ILLEGAL MOVE";
+				message(p);
+			}
+			else
+			{
+				char p[] = "INVALID MOVE!! ";
+				message(p);
+			}
 		}
-		else
+		else if (move(x, y) != 0)
 		{
 			turn = !turn;
 			// message("");
 			display();
 		}
+		unmark();
 		skeleton_box(prev_x, prev_y);
 		display();
-		prev_x = prev_y = 9;
+		prev_x = prev_y = NONE;
 		select_p = 0;
 	}
 }
 
-void Chessboard::setKing(void (*displ)(int, int, int))
+template <int W, int H>
+void BasicChessboard<W, H>::setKing(void (*displ)(int, int, int))
 // Initialise King by using the funtion pointer to display King
 {
 	dKing = displ;
-	board[4][0] = player[0][0] = new King(4, 0, 99, 0, 1, displ, clearbox);
-	board[4][7] = player[1][0] = new King(4, 7, 99, 1, -1, displ, clearbox);
+	board[W / 2][0] = player[0][0] = new King(W / 2, 0, 99, 0, 1, displ, clearbox);
+	board[W / 2][H - 1] = player[1][0] = new King(W / 2, H - 1, 99, 1, -1, displ, clearbox);
 }
 
-void Chessboard::setQueen(void (*displ)(int, int, int))
+template <int W, int H>
+void BasicChessboard<W, H>::setQueen(void (*displ)(int, int, int))
 // Initialise Queen by using the funtion pointer to display Queen
 {
 	dQueen = displ;
-	board[3][0] = player[0][1] = new Queen(3, 0, 5, 0, 1, displ, clearbox);
-	board[3][7] = player[1][1] = new Queen(3, 7, 5, 1, -1, displ, clearbox);
+	board[W / 2 - 1][0] = player[0][1] = new Queen(W / 2 - 1, 0, 5, 0, 1, displ, clearbox);
+	board[W / 2 - 1][H - 1] = player[1][1] = new Queen(W / 2 - 1, H - 1, 5, 1, -1, displ, clearbox);
 }
 
-void Chessboard::setBishop(void (*displ)(int, int, int))
+template <int W, int H>
+void BasicChessboard<W, H>::setBishop(void (*displ)(int, int, int))
 // Initialise Bishop by using the funtion pointer to display Bishop
 {
 	dBishop = displ;
 	board[2][0] = player[0][2] = new Bishop(2, 0, 4, 0, 1, displ, clearbox);
-	board[5][0] = player[0][3] = new Bishop(5, 0, 4, 0, 1, displ, clearbox);
-	board[2][7] = player[1][2] = new Bishop(2, 7, 4, 1, -1, displ, clearbox);
-	board[5][7] = player[1][3] = new Bishop(5, 7, 4, 1, -1, displ, clearbox);
+	board[W - 3][0] = player[0][3] = new Bishop(W - 3, 0, 4, 0, 1, displ, clearbox);
+	board[2][H - 1] = player[1][2] = new Bishop(2, H - 1, 4, 1, -1, displ, clearbox);
+	board[W - 3][H - 1] = player[1][3] = new Bishop(W - 3, H - 1, 4, 1, -1, displ, clearbox);
 }
 
-void Chessboard::setRook(void (*displ)(int, int, int))
+template <int W, int H>
+void BasicChessboard<W, H>::setRook(void (*displ)(int, int, int))
 // Initialise Rook by using the funtion pointer to display Rook
 {
 	dRook = displ;
 	board[0][0] = player[0][4] = new Rook(0, 0, 2, 0, 1, displ, clearbox);
-	board[7][0] = player[0][5] = new Rook(7, 0, 2, 0, 1, displ, clearbox);
-	board[0][7] = player[1][4] = new Rook(0, 7, 2, 1, -1, displ, clearbox);
-	board[7][7] = player[1][5] = new Rook(7, 7, 2, 1, -1, displ, clearbox);
+	board[W - 1][0] = player[0][5] = new Rook(W - 1, 0, 2, 0, 1, displ, clearbox);
+	board[0][H - 1] = player[1][4] = new Rook(0, H - 1, 2, 1, -1, displ, clearbox);
+	board[W - 1][H - 1] = player[1][5] = new Rook(W - 1, H - 1, 2, 1, -1, displ, clearbox);
 }
 
-void Chessboard::setKnight(void (*displ)(int, int, int))
+template <int W, int H>
+void BasicChessboard<W, H>::setKnight(void (*displ)(int, int, int))
 {
 	// Initialise Knight by using function pointer to display Knight
 	dKnight = displ;
 	board[1][0] = player[0][6] = new Knight(1, 0, 3, 0, 1, displ, clearbox);
-	board[6][0] = player[0][7] = new Knight(6, 0, 3, 0, 1, displ, clearbox);
-	board[1][7] = player[1][6] = new Knight(1, 7, 3, 1, -1, displ, clearbox);
-	board[6][7] = player[1][7] = new Knight(6, 7, 3, 1, -1, displ, clearbox);
+	board[W - 2][0] = player[0][7] = new Knight(W - 2, 0, 3, 0, 1, displ, clearbox);
+	board[1][H - 1] = player[1][6] = new Knight(1, H - 1, 3, 1, -1, displ, clearbox);
+	board[W - 2][H - 1] = player[1][7] = new Knight(W - 2, H - 1, 3, 1, -1, displ, clearbox);
 }
 
-void Chessboard::setPawn(void (*displ)(int, int, int))
+template <int W, int H>
+void BasicChessboard<W, H>::setPawn(void (*displ)(int, int, int))
 {
 	// Initialise Pawn by using funtion pointer to display Pawn
 	dPawn = displ;
-	for (int i = 0; i < 8; i++)
+	for (int i = 0; i < W; i++)
 		board[i][1] = player[0][i + 8] = new Pawn(i, 1, 1, 0, 1, displ, clearbox);
-	for (int i = 0; i < 8; i++)
-		board[i][6] = player[1][i + 8] = new Pawn(i, 6, 1, 1, -1, displ, clearbox);
-}
\ No newline at end of file
+	for (int i = 0; i < W; i++)
+		board[i][H - 2] = player[1][i + 8] = new Pawn(i, H - 2, 1, 1, -1, displ, clearbox);
+}
+
+// The 8x8 board used by the UI, the engine and the tools
+typedef BasicPiece<8, 8> Piece;
+typedef BasicRook<8, 8> Rook;
+typedef BasicBishop<8, 8> Bishop;
+typedef BasicQueen<8, 8> Queen;
+typedef BasicKnight<8, 8> Knight;
+typedef BasicPawn<8, 8> Pawn;
+typedef BasicKing<8, 8> King;
+typedef BasicUndoObj<8, 8> UndoObj;
+typedef BasicPackedBoard<8, 8> PackedBoard;
+typedef BasicChessboard<8, 8> Chessboard;
+
+// 10x8 board for variants. Instantiated here so that every program checks it still compiles.
+// The back rank has the usual Pieces only, so two of its squares stay empty
+typedef BasicChessboard<10, 8> Chessboard10x8;
+template class BasicChessboard<10, 8>;
+
+#endif
@@ -0,0 +1,303 @@
+#include "engine.cpp"
+#include "archive.cpp"
+#include "training.cpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
+/*	Training data generator.
+
+	Self-play games run on all cores. Positions are sampled from them and written as fixed-size
+	TrainingRecords (see training.cpp):
+
+		datagen -out file [-positions n] [-threads n] [-engine settings] [-ms n] [-random n]
+				[-skip n] [-sample p] [-dedup bits]
+
+	-engine takes settings as in EngineOptions::parse (default depth=3), -ms caps the time per move,
+	the first -random plies of a game are random moves and -skip plies are never sampled, -sample is
+	the probability of keeping a position, and -dedup gives the size (2^bits keys) of the table used
+	to drop positions that were already written. Only quiet positions are kept : not in check, and
+	the engine's best move is not a capture.
+
+	Records are collected per game (the result is only known at the end) and copied into one of
+	two preallocated buffers; a writer thread writes a full buffer while the games fill the other.
+*/
+
+#define BUFFER_RECORDS (1 << 16)
+
+class DataWriter // Double-buffered writer of TrainingRecords
+{
+public:
+	FILE *fp;
+	vector<TrainingRecord> buffer[2];
+	int filling;			// buffer being filled by the games
+	size_t used;			// records in buffer[filling]
+	size_t pending;			// records of the other buffer still to be written, 0 if none
+	uint64_t written;		// records handed to the writer so far
+	uint64_t limit;			// stop accepting records after this many
+	int closing;
+	int failed;				// a write failed : no more records are accepted
+	mutex lock;
+	condition_variable wake, drained;
+	thread writer;
+	DataWriter(FILE *f, uint64_t max);
+	int add(const TrainingRecord *r, size_t n);
+	int close();
+	void run();
+};
+
+DataWriter::DataWriter(FILE *f, uint64_t max)
+{
+	fp = f;
+	buffer[0].resize(BUFFER_RECORDS);
+	buffer[1].resize(BUFFER_RECORDS);
+	filling = 0;
+	used = pending = 0;
+	written = 0;
+	limit = max;
+	closing = failed = 0;
+	writer = thread(&DataWriter::run, this);
+}
+
+int DataWriter::add(const TrainingRecord *r, size_t n)
+// copy n records into the buffer. Returns 0 once "limit" records have been accepted, or a write failed
+{
+	unique_lock<mutex> guard(lock);
+	for (size_t i = 0; i < n; i++)
+	{
+		if (written >= limit || failed)
+			return 0;
+		if (used == BUFFER_RECORDS)
+		{
+			// hand the full buffer to the writer, waiting if it is still writing the other one
+			while (pending != 0)
+				drained.wait(guard);
+			pending = used;
+			filling = !filling;
+			used = 0;
+			wake.notify_one();
+		}
+		buffer[filling][used++] = r[i];
+		written++;
+	}
+	return written < limit && !failed;
+}
+
+int DataWriter::close() // write what is left and stop the writer thread. Returns 0 if a write failed
+{
+	{
+		unique_lock<mutex> guard(lock);
+		while (pending != 0)
+			drained.wait(guard);
+		pending = used;
+		filling = !filling;
+		used = 0;
+		closing = 1;
+		wake.notify_one();
+	}
+	writer.join();
+	return !failed;
+}
+
+void DataWriter::run()
+{
+	unique_lock<mutex> guard(lock);
+	for (;;)
+	{
+		while (pending == 0 && !closing)
+			wake.wait(guard);
+		if (pending != 0)
+		{
+			size_t n = pending;
+			TrainingRecord *data = &buffer[!filling][0];
+			guard.unlock(); // the games keep filling the other buffer meanwhile
+			int ok = fwrite(data, sizeof(TrainingRecord), n, fp) == n;
+			guard.lock();
+			if (!ok)
+				failed = 1;
+			pending = 0;
+			drained.notify_all();
+		}
+		else if (closing)
+			return;
+	}
+}
+
+class Generator
+{
+public:
+	EngineOptions opt;
+	double ms;
+	int random_plies, skip_plies;
+	double sample;
+	vector<atomic<uint64_t> > seen; // keys of written positions, one per slot (later keys replace earlier ones)
+	DataWriter *out;
+	atomic<uint64_t> games;
+	Generator();
+	void init(int dedup_bits);
+	int duplicate(uint64_t key);
+	int play(mt19937_64 &rng, Engine &e, vector<TrainingRecord> &records);
+	void worker(int id);
+};
+
+Generator::Generator()
+{
+	opt.max_depth = 3;
+	ms = 1000;
+	random_plies = 8;
+	skip_plies = 8;
+	sample = 0.25;
+	out = NULL;
+	games = 0;
+}
+
+void Generator::init(int dedup_bits) // allocate the table of written keys
+{
+	vector<atomic<uint64_t> > table((size_t)1 << dedup_bits);
+	seen.swap(table);
+	for (size_t i = 0; i < seen.size(); i++)
+		seen[i] = 0;
+}
+
+int Generator::duplicate(uint64_t key) // 1 if the position was probably already written
+{
+	atomic<uint64_t> &slot = seen[key & (seen.size() - 1)];
+	return slot.exchange(key, memory_order_relaxed) == key;
+}
+
+int Generator::play(mt19937_64 &rng, Engine &e, vector<TrainingRecord> &records)
+// play a game and keep its sampled positions in records. Returns the result of the game
+{
+	Chessboard c;
+	vector<Move> list;
+	vector<uint64_t> keys;
+	uniform_real_distribution<double> uniform(0, 1);
+	e.clear();
+	records.clear();
+	for (int ply = 0;; ply++)
+	{
+		uint64_t key = c.key();
+		keys.push_back(key);
+		int result = adjudicate(c, keys, ply);
+		if (result != RESULT_UNKNOWN)
+			return result;
+
+		if (ply < random_plies)
+		{
+			c.legal_moves(list);
+			c.make(list[rng() % list.size()]);
+			continue;
+		}
+		int score, depth;
+		e.history = keys;
+		e.history.pop_back();
+		Move m = e.think(c, ms, score, depth);
+		if (ply >= skip_plies && c.board[m.fx][m.fy] == NULL && !c.attacked(c.turn) &&
+			score > -MATE + MAX_PLY && score < MATE - MAX_PLY && uniform(rng) < sample && !duplicate(key))
+		{
+			TrainingRecord r;
+			c.pack(r.board);
+			r.score = score;
+			r.turn = c.turn;
+			r.ply = ply;
+			r.reserved = 0;
+			records.push_back(r);
+		}
+		c.make(m);
+	}
+}
+
+void Generator::worker(int id)
+{
+	mt19937_64 rng(0x5EED0000ULL + id);
+	Engine e(opt);
+	vector<TrainingRecord> records;
+	records.reserve(512);
+	for (;;)
+	{
+		int result = play(rng, e, records);
+		for (int i = 0; i < records.size(); i++)
+			records[i].result = result;
+		games++;
+		if (!out->add(records.size() ? &records[0] : NULL, records.size()))
+			return;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	uint64_t total = 100000;
+	int threads = max(1, (int)thread::hardware_concurrency()), dedup_bits = 22;
+	Generator gen;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		string o = argv[i];
+		const char *v = argv[i + 1];
+		int ok = 1;
+		if (o == "-out")
+			path = v;
+		else if (o == "-positions")
+			total = atoll(v);
+		else if (o == "-threads")
+			threads = max(1, atoi(v));
+		else if (o == "-engine")
+			ok = gen.opt.parse(v);
+		else if (o == "-ms")
+			gen.ms = atof(v);
+		else if (o == "-random")
+			gen.random_plies = atoi(v);
+		else if (o == "-skip")
+			gen.skip_plies = atoi(v);
+		else if (o == "-sample")
+			gen.sample = atof(v);
+		else if (o == "-dedup")
+			ok = (dedup_bits = atoi(v)) > 0 && dedup_bits < 40;
+		else
+			ok = 0;
+		if (!ok)
+		{
+			cerr << "invalid option " << o << " " << v << endl;
+			return 1;
+		}
+	}
+	if (path == NULL)
+	{
+		cerr << "usage: " << argv[0] << " -out <file> [-positions n] [-threads n] [-engine settings] [-ms n]" << endl;
+		cerr << "       [-random plies] [-skip plies] [-sample p] [-dedup bits]" << endl;
+		return 1;
+	}
+	FILE *fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		cerr << "could not open " << path << endl;
+		return 1;
+	}
+
+	gen.init(dedup_bits);
+	DataWriter writer(fp, total);
+	gen.out = &writer;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (int i = 0; i < threads; i++)
+		workers.push_back(thread(&Generator::worker, &gen, i));
+	for (int i = 0; i < threads; i++)
+		workers[i].join();
+	int ok = writer.close();
+	if (fclose(fp) != 0)
+		ok = 0;
+	if (!ok)
+	{
+		cerr << "could not write " << path << endl;
+		return 1;
+	}
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	uint64_t n = min((uint64_t)writer.written, total);
+	cout << n << " positions from " << gen.games << " games in " << seconds << " s, "
+		 << n / seconds / threads << " positions/s per thread" << endl;
+	return 0;
+}
@@ -0,0 +1,593 @@
+#ifndef ENGINE_CPP
+#define ENGINE_CPP
+
+#include "chess.cpp"
+#include "ttable.cpp"
+#include "timeman.cpp"
+#include "weights.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/*	Chess engine : alpha-beta search with iterative deepening, a transposition table and a
+	quiescence search over captures, on a headless Chessboard.
+
+	The search makes and unmakes moves on the Chessboard it is given (Chessboard::make / unmake),
+	so the Chessboard is back in its original position when think() returns. An Engine is not
+	thread-safe, but several Engines can search different Chessboards at the same time, and another
+	thread may set "stop" to end a search early. With the "shm" setting, the transposition table is
+	shared with the other engines of the host that name the same segment (see ttable.cpp).
+*/
+
+#define MATE 30000 // Score of a checkmate, minus the distance to it in plies
+#define INF 32000
+#define MAX_PLY 64
+
+// Terms of the evaluation besides material, counted for white minus black and multiplied by their
+// weights. Penalties are counted negative, so that all weights are positive
+#define TERM_CENTRE 0		  // per minor Piece, 8 minus its distance to the centre, unless a Pawn attacks it
+#define TERM_PAWN_ADVANCE 1  // per rank a Pawn has advanced
+#define TERM_PAWN_DOUBLED 2  // per Pawn with another Pawn of its player in front of it
+#define TERM_PAWN_ISOLATED 3 // no Pawn of its player on the neighbouring files
+#define TERM_PAWN_BACKWARD 4 // its neighbours have all advanced and the square in front is attacked by a Pawn
+#define TERM_KING_SHELTER 5  // per Pawn just in front of the King, while the opponent has a Queen
+#define TERM_PAWN_PASSED 6	  // passed Pawn on rank 1 to 6 from its player's side, 6 terms
+#define TERMS 12
+#define FEATURES (6 + TERMS) // Pieces of each kind (see kind()), then the terms
+
+// Names of the weights of the terms in engine settings
+const char *term_names[TERMS] = {"centre", "pawn_advance", "pawn_doubled", "pawn_isolated", "pawn_backward", "king_shelter",
+								 "pawn_passed1", "pawn_passed2", "pawn_passed3", "pawn_passed4", "pawn_passed5", "pawn_passed6"};
+
+class EngineOptions // Settings of an Engine, so that two versions can be compared
+{
+public:
+	int max_depth; // Deepest iteration, 0 for no limit
+	int hash_mb;   // Size of the transposition table
+	int value[6];  // Value of each kind of Piece (see kind()) in centipawns
+	int weight[TERMS];
+	string shm;	   // Shared-memory segment of the transposition table, empty for a private table
+	EngineOptions();
+	int parse(const char *);
+};
+
+EngineOptions::EngineOptions()
+{
+	max_depth = 0;
+	hash_mb = 16;
+	int v[6] = {0, WEIGHT_QUEEN, WEIGHT_ROOK, WEIGHT_BISHOP, WEIGHT_KNIGHT, WEIGHT_PAWN};
+	int w[TERMS] = {WEIGHT_CENTRE, WEIGHT_PAWN_ADVANCE, WEIGHT_PAWN_DOUBLED, WEIGHT_PAWN_ISOLATED,
+					WEIGHT_PAWN_BACKWARD, WEIGHT_KING_SHELTER, WEIGHT_PAWN_PASSED};
+	for (int i = 0; i < 6; i++)
+		value[i] = v[i];
+	for (int i = 0; i < TERMS; i++)
+		weight[i] = w[i];
+}
+
+int EngineOptions::parse(const char *s)
+// read settings written as "depth=4,hash=64,q=900,r=500,b=330,n=320,p=100,shm=/chess-tt". The
+// weights of the terms are named as in term_names, e.g. "centre=1,pawn_passed1=5". Returns 0 on an
+// unknown name
+{
+	const char *names[7 + TERMS] = {"depth", "hash", "q", "r", "b", "n", "p"};
+	int *fields[7 + TERMS] = {&max_depth, &hash_mb, &value[1], &value[2], &value[3], &value[4], &value[5]};
+	for (int i = 0; i < TERMS; i++)
+	{
+		names[7 + i] = term_names[i];
+		fields[7 + i] = &weight[i];
+	}
+	while (*s != '\0')
+	{
+		const char *eq = strchr(s, '=');
+		if (eq == NULL)
+			return 0;
+		int found = 0;
+		if (eq - s == 3 && strncmp(s, "shm", 3) == 0)
+		{
+			shm.assign(eq + 1, strcspn(eq + 1, ","));
+			found = 1;
+		}
+		for (int i = 0; i < 7 + TERMS; i++)
+			if (strlen(names[i]) == eq - s && strncmp(names[i], s, eq - s) == 0)
+			{
+				*fields[i] = atoi(eq + 1);
+				found = 1;
+			}
+		if (!found)
+			return 0;
+		s = strchr(eq, ',');
+		if (s == NULL)
+			break;
+		s++;
+	}
+	return 1;
+}
+
+// Kind of bound stored in the transposition table
+#define TT_EXACT 0
+#define TT_LOWER 1 // score >= stored score
+#define TT_UPPER 2 // score <= stored score
+
+#define PAWN_TABLE (1 << 14) // Entries of the Pawn hash table
+
+struct alignas(64) PawnEntry // Pawn structure of a position, in one cache line. Bit x * 8 + y is (x, y)
+{
+	uint64_t key;		 // Chessboard::pawn_key
+	uint64_t pawns[2];	 // Pawns of each player
+	uint64_t attacks[2]; // Squares attacked by them
+	int8_t terms[TERMS]; // Pawn terms for white minus black, the others are 0
+};
+
+// Name of a move in coordinate notation ("e2e4"). out must hold 5 characters
+void move_name(Move m, char *out)
+{
+	out[0] = 'a' + m.x;
+	out[1] = '1' + m.y;
+	out[2] = 'a' + m.fx;
+	out[3] = '1' + m.fy;
+	out[4] = '\0';
+}
+
+class Line // A principal variation found by Engine::analyse
+{
+public:
+	vector<Move> pv;
+	int score; // for the player to move at the root
+	int depth;
+};
+
+class Engine
+{
+public:
+	EngineOptions opt;
+	TTable table;
+	vector<PawnEntry> pawn_table;
+	vector<uint64_t> history; // Keys of the positions of the game and of the current line, for repetitions
+	uint64_t nodes;
+	atomic<int> stop;
+	chrono::steady_clock::time_point deadline;
+	uint64_t node_limit; // the search stops when "nodes" reaches it, 0 for no limit
+	uint64_t check_mask; // the clock is read when nodes & check_mask is 0
+	TimeManager time;	 // for think() under a clock, keeps the speed measured on the previous moves
+	Engine(const EngineOptions &o = EngineOptions());
+	void clear();
+	int evaluate(Chessboard &c, int *features = NULL);
+	const PawnEntry &pawn_structure(Chessboard &c);
+	void order(Chessboard &c, vector<Move> &list, const TTEntry *tt);
+	int quiesce(Chessboard &c, int alpha, int beta, int ply);
+	int search(Chessboard &c, int depth, int alpha, int beta, int ply);
+	Move think(Chessboard &c, double ms, int &score, int &depth);
+	Move think(Chessboard &c, GameClock &clock, int &score, int &depth);
+	int deepen(Chessboard &c, int depth, int &score, Move &best);
+	void principal_variation(Chessboard &c, Move first, int depth, vector<Move> &pv);
+	void analyse(Chessboard &c, int multipv, void (*report)(const vector<Line> &, void *), void *data);
+	int out_of_time();
+};
+
+Engine::Engine(const EngineOptions &o) : opt(o)
+{
+	if (opt.shm.empty() || !table.attach(opt.shm.c_str(), opt.hash_mb))
+		table.create(opt.hash_mb); // a private table if the segment cannot be used
+	// engines with other piece values or weights must not share scores
+	pawn_table.resize(PAWN_TABLE);
+	table.salt = 0;
+	for (int i = 0; i < 6; i++)
+		table.salt = (table.salt ^ (uint64_t)opt.value[i]) * 0x100000001B3ULL;
+	for (int i = 0; i < TERMS; i++)
+		table.salt = (table.salt ^ (uint64_t)opt.weight[i]) * 0x100000001B3ULL;
+	clear();
+}
+
+void Engine::clear() // forget everything learnt, e.g. before a new game
+{
+	table.clear();
+	memset((void *)&pawn_table[0], 0, pawn_table.size() * sizeof(PawnEntry)); // key 0 is right for no Pawns
+	history.clear();
+	nodes = 0;
+	node_limit = 0;
+	check_mask = 1023;
+	stop = 0;
+}
+
+int Engine::out_of_time() // checked every check_mask + 1 nodes
+{
+	return (node_limit != 0 && nodes >= node_limit) || chrono::steady_clock::now() >= deadline;
+}
+
+int Engine::evaluate(Chessboard &c, int *features)
+// score of the position for the player to move. If features is not NULL, it receives the FEATURES
+// counts for white minus black, whose weighted sum is the score for white
+{
+	const PawnEntry &pawns = pawn_structure(c);
+	int n[FEATURES] = {}, queens[2] = {0, 0};
+	for (int i = 0; i < TERMS; i++)
+		n[6 + i] = pawns.terms[i];
+	for (int i = 0; i < 8; i++)
+		for (int j = 0; j < 8; j++)
+		{
+			Piece *p = c.board[i][j];
+			if (p == NULL)
+				continue;
+			int k = kind(p), sign = p->color == 0 ? 1 : -1;
+			if (k == 1)
+				queens[p->color] = 1;
+			n[k] += sign;
+			// minor Pieces are better in the centre, unless a Pawn can chase them away
+			if ((k == 3 || k == 4) && !((pawns.attacks[!p->color] >> (i * 8 + j)) & 1))
+				n[6 + TERM_CENTRE] += sign * (8 - (abs(2 * i - 7) + abs(2 * j - 7)));
+		}
+	for (int color = 0; color < 2; color++)
+	{
+		Piece *k = c.player[color][0];
+		if (!queens[!color] || k == NULL)
+			continue;
+		int dir = color == 0 ? 1 : -1;
+		for (int x = k->x - 1; x <= k->x + 1; x++)
+			for (int y = k->y + dir; y != k->y + 3 * dir; y += dir)
+				if (x >= 0 && x < 8 && y >= 0 && y < 8 && ((pawns.pawns[color] >> (x * 8 + y)) & 1))
+					n[6 + TERM_KING_SHELTER] += dir;
+	}
+	int score = 0;
+	for (int i = 0; i < 6; i++)
+		score += n[i] * opt.value[i];
+	for (int i = 0; i < TERMS; i++)
+		score += n[6 + i] * opt.weight[i];
+	if (features != NULL)
+		memcpy(features, n, sizeof(n));
+	return c.turn == 0 ? score : -score;
+}
+
+const PawnEntry &Engine::pawn_structure(Chessboard &c)
+// Pawn masks and structure terms (advanced, doubled, isolated, backward and passed Pawns), from the
+// Pawn hash table when the same Pawns were seen before
+{
+	STAT_INC(STAT_PAWN_PROBE);
+	PawnEntry &e = pawn_table[c.pawn_key & (PAWN_TABLE - 1)];
+	if (e.key == c.pawn_key)
+	{
+		STAT_INC(STAT_PAWN_HIT);
+		return e;
+	}
+	e.key = c.pawn_key;
+	e.pawns[0] = e.pawns[1] = e.attacks[0] = e.attacks[1] = 0;
+	memset(e.terms, 0, sizeof(e.terms));
+	for (int x = 0; x < 8; x++)
+		for (int y = 1; y < 7; y++)
+		{
+			Piece *p = c.board[x][y];
+			if (p == NULL || p->points != 1)
+				continue;
+			int y2 = y + p->dir;
+			e.pawns[p->color] |= 1ULL << (x * 8 + y);
+			if (x > 0)
+				e.attacks[p->color] |= 1ULL << ((x - 1) * 8 + y2);
+			if (x < 7)
+				e.attacks[p->color] |= 1ULL << ((x + 1) * 8 + y2);
+		}
+	for (int color = 0; color < 2; color++)
+		for (int x = 0; x < 8; x++)
+			for (int y = 1; y < 7; y++)
+			{
+				if (!((e.pawns[color] >> (x * 8 + y)) & 1))
+					continue;
+				// squares of a file in front of the Pawn, and at its rank or behind, as one byte
+				uint64_t front = color == 0 ? 0xFE << y & 0xFF : (1 << y) - 1, rest = 0xFF & ~front;
+				uint64_t file = front << (x * 8), sides = 0, sides_rest = 0;
+				if (x > 0)
+					sides |= front << ((x - 1) * 8), sides_rest |= rest << ((x - 1) * 8);
+				if (x < 7)
+					sides |= front << ((x + 1) * 8), sides_rest |= rest << ((x + 1) * 8);
+				int rank = color == 0 ? y : 7 - y, sign = color == 0 ? 1 : -1;
+				e.terms[TERM_PAWN_ADVANCE] += sign * (rank - 1);
+				if (e.pawns[color] & file)
+					e.terms[TERM_PAWN_DOUBLED] -= sign;
+				if (!(e.pawns[color] & (sides | sides_rest)))
+					e.terms[TERM_PAWN_ISOLATED] -= sign;
+				else if (!(e.pawns[color] & sides_rest) && ((e.attacks[!color] >> (x * 8 + y + (color == 0 ? 1 : -1))) & 1))
+					e.terms[TERM_PAWN_BACKWARD] -= sign;
+				if (!(e.pawns[!color] & (file | sides)))
+					e.terms[TERM_PAWN_PASSED + rank - 1] += sign;
+			}
+	return e;
+}
+
+void Engine::order(Chessboard &c, vector<Move> &list, const TTEntry *tt)
+// best move from the table first, then captures of the most valuable Piece by the least valuable one
+{
+	vector<int> rank(list.size());
+	for (int i = 0; i < list.size(); i++)
+	{
+		Move &m = list[i];
+		if (tt != NULL && tt->x == m.x && tt->y == m.y && tt->fx == m.fx && tt->fy == m.fy)
+			rank[i] = 1 << 20;
+		else if (c.board[m.fx][m.fy] != NULL)
+			rank[i] = 1000 + opt.value[kind(c.board[m.fx][m.fy])] - opt.value[kind(c.board[m.x][m.y])] / 10;
+		else
+			rank[i] = 0;
+	}
+	// insertion sort, lists are short
+	for (int i = 1; i < list.size(); i++)
+		for (int j = i; j > 0 && rank[j] > rank[j - 1]; j--)
+		{
+			swap(rank[j], rank[j - 1]);
+			swap(list[j], list[j - 1]);
+		}
+}
+
+int Engine::quiesce(Chessboard &c, int alpha, int beta, int ply)
+// only captures are searched, so that the evaluation is not done in the middle of an exchange
+{
+	if ((++nodes & check_mask) == 0 && out_of_time())
+		stop = 1;
+	if (stop)
+		return 0;
+	int stand = evaluate(c);
+	if (stand >= beta || ply >= MAX_PLY)
+		return stand;
+	if (stand > alpha)
+		alpha = stand;
+	vector<Move> list, captures;
+	c.legal_moves(list);
+	for (int i = 0; i < list.size(); i++)
+		if (c.board[list[i].fx][list[i].fy] != NULL)
+			captures.push_back(list[i]);
+	order(c, captures, NULL);
+	for (int i = 0; i < captures.size(); i++)
+	{
+		c.make(captures[i]);
+		int score = -quiesce(c, -beta, -alpha, ply + 1);
+		c.unmake();
+		if (stop)
+			return 0;
+		if (score >= beta)
+			return score;
+		if (score > alpha)
+			alpha = score;
+	}
+	return alpha;
+}
+
+int Engine::search(Chessboard &c, int depth, int alpha, int beta, int ply)
+{
+	if ((++nodes & check_mask) == 0 && out_of_time())
+		stop = 1;
+	if (stop)
+		return 0;
+
+	uint64_t key = c.key();
+	if (ply > 0)
+		for (int i = (int)history.size() - 2; i >= 0; i -= 2)
+			if (history[i] == key)
+				return 0; // repetition, scored as a draw
+
+	TTEntry entry, *tt = &entry;
+	if (!table.probe(key, entry))
+		tt = NULL;
+	else if (ply > 0 && tt->depth >= depth)
+	{
+		int s = tt->score;
+		if (s > MATE - MAX_PLY)
+			s -= ply;
+		else if (s < -MATE + MAX_PLY)
+			s += ply;
+		if (tt->flag == TT_EXACT || (tt->flag == TT_LOWER && s >= beta) || (tt->flag == TT_UPPER && s <= alpha))
+			return s;
+	}
+
+	vector<Move> list;
+	c.legal_moves(list);
+	if (list.size() == 0)
+		return c.attacked(c.turn) ? -MATE + ply : 0; // checkmate or stalemate
+	if (depth <= 0 || ply >= MAX_PLY)
+		return quiesce(c, alpha, beta, ply);
+
+	order(c, list, tt);
+	int best = -INF, flag = TT_UPPER, alpha0 = alpha;
+	Move best_move = list[0];
+	history.push_back(key);
+	for (int i = 0; i < list.size(); i++)
+	{
+		c.make(list[i]);
+		int score = -search(c, depth - 1, -beta, -alpha, ply + 1);
+		c.unmake();
+		if (stop)
+			break;
+		if (score > best)
+		{
+			best = score;
+			best_move = list[i];
+		}
+		if (score > alpha)
+			alpha = score;
+		if (alpha >= beta)
+			break;
+	}
+	history.pop_back();
+	if (stop)
+		return 0;
+
+	if (best >= beta)
+		flag = TT_LOWER;
+	else if (best > alpha0)
+		flag = TT_EXACT;
+	TTEntry e;
+	if (!table.probe(key, e) || depth >= e.depth) // keep deeper results of the same position
+	{
+		int s = best;
+		if (s > MATE - MAX_PLY)
+			s += ply;
+		else if (s < -MATE + MAX_PLY)
+			s -= ply;
+		e.key = key;
+		e.score = s;
+		e.depth = depth;
+		e.flag = flag;
+		e.x = best_move.x;
+		e.y = best_move.y;
+		e.fx = best_move.fx;
+		e.fy = best_move.fy;
+		table.store(e);
+	}
+	return best;
+}
+
+Move Engine::think(Chessboard &c, double ms, int &score, int &depth)
+// best move for the player to move, searching for about "ms" milliseconds (iterative deepening).
+// score and depth are those of the last completed iteration
+{
+	deadline = chrono::steady_clock::now() + chrono::microseconds((long long)(ms * 1000));
+	stop = 0;
+	score = 0;
+	depth = 0;
+	vector<Move> list;
+	c.legal_moves(list);
+	if (list.size() == 0)
+		return Move(9, 9, 9, 9);
+	Move best = list[0];
+	for (int d = 1; opt.max_depth == 0 || d <= opt.max_depth; d++)
+	{
+		int s;
+		if (!deepen(c, d, s, best))
+			break;
+		score = s;
+		depth = d;
+		if (s > MATE - MAX_PLY || s < -MATE + MAX_PLY || list.size() == 1)
+			break; // nothing more to find
+	}
+	return best;
+}
+
+Move Engine::think(Chessboard &c, GameClock &clock, int &score, int &depth)
+// best move for the player to move, spending the time of its clock as planned by the TimeManager
+{
+	time.plan(clock.remaining(c.turn) * 1000, clock.tc.inc * 1000, clock.moves_to_go(c.turn));
+	deadline = time.start + chrono::microseconds((long long)(time.hard_ms * 1000));
+	check_mask = time.check_interval() - 1;
+	stop = 0;
+	score = 0;
+	depth = 0;
+	vector<Move> list;
+	c.legal_moves(list);
+	if (list.size() == 0)
+		return Move(9, 9, 9, 9);
+	Move best = list[0];
+	uint64_t first = nodes;
+	for (int d = 1; (opt.max_depth == 0 || d <= opt.max_depth) && time.next_iteration(); d++)
+	{
+		uint64_t before = nodes;
+		int s;
+		if (!deepen(c, d, s, best))
+			break;
+		score = s;
+		depth = d;
+		time.iteration(nodes - before, best.x * 1000 + best.y * 100 + best.fx * 10 + best.fy);
+		if (s > MATE - MAX_PLY || s < -MATE + MAX_PLY || list.size() == 1)
+			break;
+	}
+	time.done(nodes - first);
+	check_mask = 1023;
+	return best;
+}
+
+int Engine::deepen(Chessboard &c, int depth, int &score, Move &best)
+// one iteration of think() : search to "depth" and read the best move from the table, leaving best
+// as it is if it is not there. Returns 0, with score and best unchanged, if the search was stopped
+{
+	int s = search(c, depth, -INF, INF, 0);
+	if (stop)
+		return 0;
+	TTEntry tt;
+	if (table.probe(c.key(), tt))
+		best = Move(tt.x, tt.y, tt.fx, tt.fy);
+	score = s;
+	return 1;
+}
+
+void Engine::principal_variation(Chessboard &c, Move first, int depth, vector<Move> &pv)
+// the line starting with "first" that the search expects, read from the transposition table
+{
+	pv.clear();
+	pv.push_back(first);
+	c.make(first);
+	while (pv.size() < depth)
+	{
+		uint64_t key = c.key();
+		TTEntry tt;
+		if (!table.probe(key, tt) || tt.x > 7 || tt.y > 7 || tt.fx > 7 || tt.fy > 7 ||
+			c.board[tt.x][tt.y] == NULL || c.board[tt.x][tt.y]->color != c.turn || !c.legal(tt.x, tt.y, tt.fx, tt.fy))
+			break;
+		Move m(tt.x, tt.y, tt.fx, tt.fy);
+		pv.push_back(m);
+		c.make(m);
+	}
+	for (int i = 0; i < pv.size(); i++)
+		c.unmake();
+}
+
+void Engine::analyse(Chessboard &c, int multipv, void (*report)(const vector<Line> &, void *), void *data)
+// analyse the position until "stop" is set, deeper and deeper, calling report with the best "multipv"
+// lines after every completed iteration. The transposition table is kept, so analysing a position
+// close to the previous one starts from what was learnt there. Unlike think(), "stop" is not reset
+{
+	deadline = chrono::steady_clock::time_point::max();
+	vector<Move> root;
+	vector<Line> lines;
+	c.legal_moves(root);
+	if (multipv > root.size())
+		multipv = root.size();
+	uint64_t key = c.key();
+	for (int d = 1; d < MAX_PLY && !stop; d++)
+	{
+		// Best lines of the previous iteration are searched first
+		vector<Move> order_list;
+		for (int i = 0; i < lines.size(); i++)
+			order_list.push_back(lines[i].pv[0]);
+		for (int i = 0; i < root.size(); i++)
+		{
+			int seen = 0;
+			for (int j = 0; j < lines.size(); j++)
+				seen |= root[i].x == lines[j].pv[0].x && root[i].y == lines[j].pv[0].y && root[i].fx == lines[j].pv[0].fx && root[i].fy == lines[j].pv[0].fy;
+			if (!seen)
+				order_list.push_back(root[i]);
+		}
+
+		// Line k is the best line among the moves not already chosen for lines 0 .. k-1
+		vector<Line> found;
+		vector<int> used(order_list.size(), 0);
+		history.push_back(key);
+		for (int k = 0; k < multipv && !stop; k++)
+		{
+			int alpha = -INF, best = -1;
+			for (int i = 0; i < order_list.size() && !stop; i++)
+			{
+				if (used[i])
+					continue;
+				c.make(order_list[i]);
+				int score = -search(c, d - 1, -INF, -alpha, 1);
+				c.unmake();
+				if (!stop && score > alpha)
+				{
+					alpha = score;
+					best = i;
+				}
+			}
+			if (stop || best == -1)
+				break;
+			used[best] = 1;
+			Line l;
+			l.score = alpha;
+			l.depth = d;
+			principal_variation(c, order_list[best], d, l.pv);
+			found.push_back(l);
+		}
+		history.pop_back();
+		if (stop)
+			break;
+		lines = found;
+		report(lines, data);
+		if (root.size() == 0)
+			break;
+	}
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "posindex.cpp"
+#include <chrono>
+
+// Command line tool to build a position index from a game archive and to query it
+//   indexer build <archive> <index> [threads]
+//   indexer query <index> "<FEN>"
+
+double elapsed_ms(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 4 && strcmp(argv[1], "build") == 0)
+	{
+		int threads = argc >= 5 ? atoi(argv[4]) : thread::hardware_concurrency();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		if (!build_index(argv[2], argv[3], threads))
+		{
+			cerr << "could not build " << argv[3] << " from " << argv[2] << endl;
+			return 1;
+		}
+		PositionIndex index;
+		if (!index.open(argv[3]))
+		{
+			cerr << "could not open " << argv[3] << endl;
+			return 1;
+		}
+		cout << index.head->entries << " positions indexed in " << elapsed_ms(start) << " ms" << endl;
+		return 0;
+	}
+	if (argc >= 4 && strcmp(argv[1], "query") == 0)
+	{
+		PositionIndex index;
+		Chessboard c;
+		if (!index.open(argv[2]))
+		{
+			cerr << "could not open " << argv[2] << endl;
+			return 1;
+		}
+		if (!c.setup(argv[3]))
+		{
+			cerr << "invalid FEN" << endl;
+			return 1;
+		}
+		vector<IndexEntry> found;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		index.lookup(c.key(), found);
+		double ms = elapsed_ms(start);
+		for (int i = 0; i < found.size(); i++)
+			cout << "game " << found[i].game << " ply " << found[i].ply << endl;
+		cout << found.size() << " games, " << ms << " ms" << endl;
+		return 0;
+	}
+	cerr << "usage: " << argv[0] << " build <archive> <index> [threads]" << endl;
+	cerr << "       " << argv[0] << " query <index> \"<FEN>\"" << endl;
+	return 1;
+}
@@ -1,13 +1,23 @@
 #include <GL/glut.h>
 #include <math.h>
 #include "chess.cpp"
+#include "archive.cpp"
+#include "posindex.cpp"
+#include "analysis.cpp"
+#include "replay.cpp"
+#include "variation.cpp"
 #include <string.h>
+#include <limits.h>
 
 using namespace std;
 
 // Defining the size of the window
 int w = 1366, h = 685, d, offset = 2;
 
+// Archive used by the SAVE GAME / LOAD GAME menu options, and its position index (built by the indexer tool)
+const char *archive_path = "games.cga";
+const char *index_path = "games.idx";
+
 // Declaring the function prototypes
 void rectangle(int a, int b, int c, int d);
 void triangle(int a, int b, int c, int d, int e, int f);
@@ -18,10 +28,18 @@ void board_layout();
 void skeleton_box(int x, int y);
 void clearbox(int x, int y);
 void highlight(int x, int y);
+void mark_target(int x, int y);
 void message(char *);
 void display();
+void start_replay();
 
-Chessboard c1(skeleton_box, clearbox, highlight, display, message);
+Chessboard c1(skeleton_box, clearbox, highlight, display, message, mark_target);
+VariationTree tree; // Every line played on c1, followed by BACK / FORWARD / NEXT VARIATION
+InputLog input_log; // Input recorded with --record or replayed with --replay
+int replaying = 0;	// 1 once a replay is loaded, 2 while it runs
+TimeControl clock_tc(300, 3); // Time control of the game clock, set with --clock
+GameClock game_clock;		  // Shown at the top of the message box while CLOCK ON/OFF is on
+int clocking = 0;
 
 void myinit()
 {
@@ -42,6 +60,7 @@ void mreshape(int wx, int hx)
 	{
 		board_layout();
 		c1.redisplay();
+		start_replay(); // the board is drawn, recorded input can be replayed
 		return;
 	}
 
@@ -62,15 +81,40 @@ void message_box()
 	rect_box(750, 400, 1300, 650);
 }
 
-// Function to display a message in the message box after clearing it
+// Function to display the game clock at the top of the message box, over the previous one
+void clock_line()
+{
+	glColor3f(0, 0, 0);
+	rectangle(752, 618, 1298, 648);
+	if (!clocking)
+		return;
+	char p[64];
+	game_clock.text(p);
+	glColor3f(1, 1, 1);
+	glRasterPos2f(770, 625);
+	for (int i = 0; p[i] != '\0'; i++)
+		glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, p[i]);
+}
+
+// Function to display a message in the message box after clearing it. '\n' starts a new line
 void message(char *msg)
 {
 	message_box();
+	clock_line();
 
-	glRasterPos2f(770, 600);
+	int line = 600;
 	glColor3f(1, 1, 1);
+	glRasterPos2f(770, line);
 	for (int i = 0; i < strlen(msg); i++)
-		glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, msg[i]);
+		if (msg[i] == '\n')
+		{
+			line -= 22;
+			if (line < 410)
+				break; // below the message box
+			glRasterPos2f(770, line);
+		}
+		else
+			glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, msg[i]);
 }
 
 // Function to display a King at position (x, y) with a specified color
@@ -259,9 +303,10 @@ void circle(int x, int y, int r)
 
 void board_layout()
 {
+	STAT_TIMER(TIMER_BOARD_LAYOUT);
 	glLineWidth(2);
-	for (int i = 0; i < 8; i++)
-		for (int j = 0; j < 8; j++)
+	for (int i = 0; i < Chessboard::WIDTH; i++)
+		for (int j = 0; j < Chessboard::HEIGHT; j++)
 			clearbox(i, j);
 }
 
@@ -309,18 +354,31 @@ void highlight(int x, int y)
 	rect_box(x * d + offset, y * d + offset, (x + 1) * d + offset, (y + 1) * d + offset);
 }
 
+// Mark the box at (x, y) as a legal destination of the selected piece
+void mark_target(int x, int y)
+{
+	glColor3ub(46, 139, 87); // Marker color
+	glLineWidth(3);
+	rect_box(x * d + offset + d / 8, y * d + offset + d / 8, (x + 1) * d + offset - d / 8, (y + 1) * d + offset - d / 8);
+}
+
 void display()
 {
-	glFlush();
+	if (replaying != 2)
+	{
+		glFlush();
+		return;
+	}
+	glFinish(); // during a replay every frame is timed once drawn
+	input_log.frame();
 }
 
 // Initialize the Chessboard layout and chess engine
 void initboard()
 {
-	d = h;
-	if (w < d)
-		d = w;
-	d = d / 8;
+	d = h / Chessboard::HEIGHT; // largest square size that fits the window
+	if (w / Chessboard::WIDTH < d)
+		d = w / Chessboard::WIDTH;
 	board_layout();
 
 	c1.setKing(king);
@@ -329,6 +387,7 @@ void initboard()
 	c1.setRook(rook);
 	c1.setKnight(knight);
 	c1.setPawn(pawn);
+	tree.reset(c1);
 }
 
 int m = 0;
@@ -339,48 +398,424 @@ void reset(int v)
 	m = 0;
 }
 
+// A move was played on c1 : the player who made it punches the clock, which stops when the game is over
+void punch_clock()
+{
+	if (!clocking || !game_clock.running)
+		return;
+	game_clock.punch();
+	vector<Move> list;
+	c1.legal_moves(list);
+	if (list.size() == 0)
+		game_clock.stop();
+	clock_line();
+	display();
+}
+
+// Handle a left click at window position (x, y)
+void click(int x, int y)
+{
+	y = h - y; // Adjust the y-coordinate to match the coordinate system
+
+	if (x <= offset || y <= offset || x > (Chessboard::WIDTH * d + offset) || y > (Chessboard::HEIGHT * d + offset))
+		return; // Clicked outside the Chessboard
+
+	int turn = c1.turn;
+	c1.select((x - offset - 1) / d, (y - offset - 1) / d); // Handle piece selection
+	if (c1.turn != turn)
+	{
+		tree.record(c1); // a move was played
+		punch_clock();
+	}
+}
+
+
 void mouse(int b, int s, int x, int y)
 {
 	if (m == 1)
 		return; // Mouse control already in progress
 
-	m = 1;
-	y = h - y; // Adjust the y-coordinate to match the coordinate system
 	if (b != GLUT_LEFT_BUTTON || s != GLUT_DOWN)
 		return; // Only handle left mouse button press events
 
-	if (x > (8 * d + offset) || y > (8 * d + offset))
-		return; // Clicked outside the Chessboard
+	m = 1;
+	input_log.log(EVENT_MOUSE, x, y);
+	click(x, y);
+	glutTimerFunc(185, reset, 0); // Re-enable mouse control after 185ms
+}
 
-	for (int i = 0; i < 8; i++)
-		for (int j = 0; j < 8; j++)
-			if (j * d + offset < x && i * d + offset < y && (j + 1) * d + offset >= x && (i + 1) * d + offset >= y)
-			{
-				x = j;
-				y = i;
-			}
+// Append the game played so far to the archive
+void save_game()
+{
+	vector<Move> moves;
+	GameRecord rec;
+	ArchiveWriter out;
+	tree.line(tree.current, moves); // the undo list may not start at the initial position
+	if (!encode_game(moves, rec) || !out.open(archive_path) || !out.add(rec) || !out.close())
+	{
+		char p[] = "COULD NOT SAVE GAME";
+		message(p);
+		return;
+	}
+	char p[] = "GAME SAVED";
+	message(p);
+}
 
-	c1.select(x, y);			  // Handle piece selection
-	glutTimerFunc(185, reset, 0); // Re-enable mouse control after 185ms
+// Replay the last game of the archive on the Chessboard
+void load_game()
+{
+	ArchiveReader in;
+	int plies, result;
+	const unsigned char *moves = NULL;
+	if (in.open(archive_path) && in.size() != 0)
+		moves = in.game(in.size() - 1, plies, result);
+	if (moves == NULL)
+	{
+		char p[] = "NO SAVED GAME";
+		message(p);
+		return;
+	}
+	board_layout();
+	c1.newgame();
+	int ok = replay_game(c1, moves, plies);
+	tree.reset(c1);
+	board_layout();
+	c1.redisplay();
+	if (!ok)
+	{
+		char p[] = "CORRUPT SAVED GAME";
+		message(p);
+	}
+	else if (result == RESULT_UNKNOWN)
+	{
+		char p[] = "GAME LOADED";
+		message(p);
+	}
+	display();
+}
+
+// List the archived games which reached the position on the Chessboard
+void find_position()
+{
+	PositionIndex index;
+	vector<IndexEntry> found;
+	if (!index.open(index_path))
+	{
+		char p[] = "NO POSITION INDEX";
+		message(p);
+		return;
+	}
+	index.lookup(c1.key(), found);
+	char p[100];
+	int n = sprintf(p, "POSITION IN %d GAMES", (int)found.size());
+	for (int i = 0; i < found.size() && i < 5; i++)
+		n += sprintf(p + n, "%s %u", i == 0 ? " :" : ",", found[i].game);
+	if (found.size() > 5)
+		strcpy(p + n, " ...");
+	message(p);
+}
+
+// Show the engine counters and timers in the message box
+void show_stats()
+{
+	char p[512];
+	stats_summary(p);
+	message(p);
+	display();
+}
+
+Analysis *analysis = NULL; // Background analysis, created the first time it is switched on
+int analysing = 0;
+uint64_t analysed_key;
+int analysis_timer_pending = 0; // 1 while an analysis_timer call is scheduled
+
+// Refresh the analysis in the message box, at most every 250ms, and restart it when the position changes
+void analysis_timer(int v)
+{
+	analysis_timer_pending = 0;
+	if (!analysing)
+		return;
+	if (c1.key() != analysed_key)
+	{
+		analysed_key = c1.key();
+		analysis->analyse(c1);
+	}
+	char p[512];
+	if (analysis->poll(p))
+	{
+		message(p);
+		display();
+	}
+	uint64_t k;
+	Line line;
+	if (analysis->result(k, line) && k == tree.nodes[tree.current].key && line.pv.size() != 0)
+		tree.annotate(tree.current, line.score, line.depth, line.pv[0]); // kept with the position
+	analysis_timer_pending = 1;
+	glutTimerFunc(250, analysis_timer, 0);
+}
+
+// Switch the background analysis on or off
+void toggle_analysis()
+{
+	if (analysis == NULL)
+		analysis = new Analysis;
+	analysing = !analysing;
+	if (analysing)
+	{
+		analysed_key = c1.key();
+		analysis->analyse(c1);
+		if (!analysis_timer_pending) // else the pending call goes on with the new analysis
+		{
+			analysis_timer_pending = 1;
+			glutTimerFunc(250, analysis_timer, 0);
+		}
+	}
+	else
+	{
+		analysis->halt();
+		char p[] = "";
+		message(p);
+		display();
+	}
+}
+
+int clock_timer_pending = 0; // 1 while a clock_timer call is scheduled
+
+// Redraw the clock every 100ms until it stops, and stop it when a player runs out of time
+void clock_timer(int v)
+{
+	clock_timer_pending = 0;
+	if (!clocking)
+		return;
+	game_clock.check_flag();
+	clock_line();
+	display();
+	if (game_clock.running)
+	{
+		clock_timer_pending = 1;
+		glutTimerFunc(100, clock_timer, 0);
+	}
+}
+
+// Start new clocks for both players, or hide them
+void toggle_clock()
+{
+	clocking = !clocking;
+	if (clocking)
+	{
+		game_clock.start(clock_tc, c1.turn);
+		if (!clock_timer_pending) // else the pending call goes on with the new clocks
+		{
+			clock_timer_pending = 1;
+			glutTimerFunc(100, clock_timer, 0);
+		}
+	}
+	else
+		game_clock.stop();
+	clock_line();
+	display();
+}
+
+// Redraw the board after moving in the variation tree, with what is known about the position
+void show_node(int moved)
+{
+	if (!moved)
+		return;
+	game_clock.stop(); // the position is no longer the game being timed
+	c1.select_p = 0;
+	c1.marked = 0;
+	c1.prev_x = c1.prev_y = Chessboard::NONE; // no piece selected
+	board_layout();
+	c1.redisplay();
+	VariationNode &n = tree.nodes[tree.current];
+	char p[100], name[5];
+	int len = sprintf(p, "PLY %d", n.depth);
+	if (n.parent != -1 && (tree.nodes[n.parent].first != tree.current || n.next != -1))
+	{
+		int index = 1, count = 0;
+		for (int i = tree.nodes[n.parent].first; i != -1; i = tree.nodes[i].next, count++)
+			if (i == tree.current)
+				index = count + 1;
+		len += sprintf(p + len, "  VARIATION %d OF %d", index, count);
+	}
+	if (n.score_depth != -1)
+	{
+		int s = c1.turn == 0 ? n.score : -n.score; // shown for white
+		move_name(n.best, name);
+		if (abs(s) > MATE - MAX_PLY)
+			sprintf(p + len, "\nSTORED DEPTH %d : %s MATES  %s", n.score_depth, s > 0 ? "WHITE" : "BLACK", name);
+		else
+			sprintf(p + len, "\nSTORED DEPTH %d : %+.2f  %s", n.score_depth, s / 100.0, name);
+	}
+	message(p);
+	display();
 }
 
 void mainmenu(int id)
 {
+	input_log.log(EVENT_MENU, id, 0);
 	if (id == 1)
-		c1.undo_move(); // Handle undo move option from the menu
+		show_node(tree.back(c1)); // the line taken back stays in the tree
+	else if (id == 2)
+		save_game();
+	else if (id == 3)
+		load_game();
+	else if (id == 4)
+		find_position();
+	else if (id == 5)
+		show_stats();
+	else if (id == 6)
+		toggle_analysis();
+	else if (id == 7)
+		show_node(tree.forward(c1));
+	else if (id == 8)
+		show_node(tree.sibling(c1));
+	else if (id == 9)
+		show_node(tree.jump(c1, 0));
+	else if (id == 10)
+		show_node(tree.jump(c1, INT_MAX)); // the end of the line
+	else if (id == 12)
+		toggle_clock();
+}
+
+#define MENU_JUMP 11 // Recorded for a jump to a typed ply, with the ply
+
+// Go to a ply of the line on the board. Returns 0 if the board did not move
+int jump_to(int ply)
+{
+	input_log.log(EVENT_MENU, MENU_JUMP, ply);
+	int moved = tree.jump(c1, ply);
+	show_node(moved);
+	return moved;
+}
+
+int typed_ply = -1; // Ply being typed, -1 if none
+
+// Digits then Enter go to that ply, Escape cancels
+void keyboard(unsigned char key, int x, int y)
+{
+	if (key >= '0' && key <= '9' && typed_ply < 100000)
+	{
+		typed_ply = (typed_ply == -1 ? 0 : typed_ply * 10) + key - '0';
+		char p[40];
+		sprintf(p, "GO TO PLY %d", typed_ply);
+		message(p);
+		display();
+	}
+	else if ((key == '\r' || key == '\n') && typed_ply != -1)
+	{
+		int ply = typed_ply;
+		typed_ply = -1;
+		if (!jump_to(ply))
+			show_node(1); // clear the typed ply
+	}
+	else if (key == 27 && typed_ply != -1)
+	{
+		typed_ply = -1;
+		show_node(1);
+	}
+}
+
+// Arrow keys move in the variation tree like the menu options
+void special(int key, int x, int y)
+{
+	if (key == GLUT_KEY_LEFT)
+		mainmenu(1);
+	else if (key == GLUT_KEY_RIGHT)
+		mainmenu(7);
+	else if (key == GLUT_KEY_DOWN)
+		mainmenu(8);
+	else if (key == GLUT_KEY_HOME)
+		mainmenu(9);
+	else if (key == GLUT_KEY_END)
+		mainmenu(10);
 }
 
 void initmenu()
 {
-	// Create a right-click menu with an "UNDO" option
+	// Create the right-click menu
 	glutCreateMenu(mainmenu);
-	glutAddMenuEntry("UNDO", 1);
+	glutAddMenuEntry("BACK", 1);
+	glutAddMenuEntry("FORWARD", 7);
+	glutAddMenuEntry("NEXT VARIATION", 8);
+	glutAddMenuEntry("START", 9);
+	glutAddMenuEntry("END", 10);
+	glutAddMenuEntry("SAVE GAME", 2);
+	glutAddMenuEntry("LOAD GAME", 3);
+	glutAddMenuEntry("FIND POSITION", 4);
+	glutAddMenuEntry("STATISTICS", 5);
+	glutAddMenuEntry("ANALYSIS ON/OFF", 6);
+	glutAddMenuEntry("CLOCK ON/OFF", 12);
 	glutAttachMenu(GLUT_RIGHT_BUTTON);
 }
 
+// Feed recorded event i to the UI and measure the time until its frame is drawn
+void replay_event(int i)
+{
+	InputEvent e = input_log.events[i];
+	double t = input_log.now();
+	input_log.last_frame = t;
+	if (e.type == EVENT_MOUSE)
+		click(e.x, e.y); // the 185ms debounce of mouse() already filtered the recording
+	else if (e.x == MENU_JUMP)
+		jump_to(e.y);
+	else
+		mainmenu(e.x);
+	glFinish();
+	input_log.latency.push_back(input_log.now() - t);
+	input_log.last_frame = -1;
+
+	if (i + 1 == input_log.events.size())
+	{
+		input_log.report(stdout);
+		exit(0);
+	}
+	// wait for the time of the next event, or go on at once if late
+	double wait = input_log.events[i + 1].t - input_log.now();
+	glutTimerFunc(wait > 0 ? (unsigned)wait : 0, replay_event, i + 1);
+}
+
+void start_replay()
+{
+	if (replaying != 1)
+		return;
+	replaying = 2;
+	if (input_log.events.size() == 0)
+	{
+		input_log.report(stdout);
+		exit(0);
+	}
+	input_log.start = chrono::steady_clock::now();
+	glutTimerFunc((unsigned)input_log.events[0].t, replay_event, 0);
+}
+
 int main(int argc, char **argv)
 {
 	glutInit(&argc, argv);
+
+	// --record <file> saves the clicks and menu choices, --replay <file> plays them back and measures latency,
+	// --clock <[moves/]base+inc> sets the time control of CLOCK ON/OFF
+	for (int i = 1; i + 1 < argc; i += 2)
+		if (strcmp(argv[i], "--clock") == 0 && !clock_tc.parse(argv[i + 1]))
+		{
+			cerr << "invalid time control " << argv[i + 1] << endl;
+			return 1;
+		}
+		else if (strcmp(argv[i], "--record") == 0 && !input_log.record(argv[i + 1]))
+		{
+			cerr << "could not write " << argv[i + 1] << endl;
+			return 1;
+		}
+		else if (strcmp(argv[i], "--replay") == 0)
+		{
+			if (!input_log.load(argv[i + 1]))
+			{
+				cerr << "could not read " << argv[i + 1] << endl;
+				return 1;
+			}
+			replaying = 1;
+		}
+
 	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
 	glutInitWindowSize(w, h);
 	glutInitWindowPosition(0, 0);
@@ -396,6 +831,8 @@ int main(int argc, char **argv)
 	glutDisplayFunc(display);
 	glutReshapeFunc(mreshape);
 	glutMouseFunc(mouse);
+	glutSpecialFunc(special);
+	glutKeyboardFunc(keyboard);
 
 	glutMainLoop();
 	return 0;
@@ -0,0 +1,98 @@
+#include "batch.cpp"
+#include <chrono>
+
+/*	Move generation check and benchmark.
+
+	perft <depth> ["FEN"]
+
+	Counts the leaves of the tree of legal moves of the given depth (the initial position by
+	default), once with Chessboard::legal_moves and once with batch_count, which counts the legal
+	moves of the positions one ply above the leaves BATCH at a time. Both counts must agree.
+*/
+
+uint64_t perft(Chessboard &c, int depth) // leaves with Chessboard::legal_moves
+{
+	vector<Move> list;
+	c.legal_moves(list);
+	if (depth == 1)
+		return list.size();
+	uint64_t n = 0;
+	for (int i = 0; i < list.size(); i++)
+	{
+		c.make(list[i]);
+		n += perft(c, depth - 1);
+		c.unmake();
+	}
+	return n;
+}
+
+class BatchPerft // leaves with batch_count
+{
+public:
+	PositionBatch batch;
+	uint64_t leaves;
+	BatchPerft() : leaves(0) {}
+	void flush();
+	void walk(Chessboard &c, int depth);
+};
+
+void BatchPerft::flush() // count the moves of the positions collected so far
+{
+	int count[BATCH];
+	if (batch.size == 0)
+		return;
+	batch_count(batch, count);
+	for (int i = 0; i < batch.size; i++)
+		leaves += count[i];
+	batch.clear();
+}
+
+void BatchPerft::walk(Chessboard &c, int depth)
+{
+	if (depth == 1)
+	{
+		batch.load(batch.size, c);
+		if (batch.size == BATCH)
+			flush();
+		return;
+	}
+	vector<Move> list;
+	c.legal_moves(list);
+	for (int i = 0; i < list.size(); i++)
+	{
+		c.make(list[i]);
+		walk(c, depth - 1);
+		c.unmake();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int depth = argc > 1 ? atoi(argv[1]) : 0;
+	Chessboard c;
+	if (depth < 1 || (argc > 2 && !c.setup(argv[2])))
+	{
+		cerr << "usage: " << argv[0] << " <depth> [\"FEN\"]" << endl;
+		return 1;
+	}
+	cout << "batch code: " << (__builtin_cpu_supports("avx2") ? "avx2" : "generic") << ", " << BATCH << " positions per batch" << endl;
+
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	uint64_t scalar = perft(c, depth);
+	double s1 = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	t0 = chrono::steady_clock::now();
+	BatchPerft b;
+	b.walk(c, depth);
+	b.flush();
+	double s2 = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	cout << "legal_moves: " << scalar << " leaves in " << s1 << " s" << endl;
+	cout << "batch_count: " << b.leaves << " leaves in " << s2 << " s" << endl;
+	if (scalar != b.leaves)
+	{
+		cout << "MISMATCH" << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,349 @@
+#ifndef PNS_CPP
+#define PNS_CPP
+
+#include "chess.cpp"
+
+/*	Mate-in-N solver using proof-number search.
+
+	The player to move (the attacker) tries to mate in at most N of its moves, that is within
+	2N - 1 plies. Attacker nodes are OR nodes (one mating move is enough) and defender nodes are
+	AND nodes (every defence must be mated). A node's proof number is the least number of leaves
+	that must be proved to prove it, its disproof number the least to disprove it.
+
+	Two variants are given :
+	- PNSolver keeps the whole tree in memory and always expands the most-proving leaf.
+	- DFPNSolver (depth-first proof-number search) keeps proof and disproof numbers in a fixed-size
+	  hash table instead, so memory does not grow with the search.
+
+	Both return 1 (mate found, "line" is the main line), 0 (no mate in N) or -1 (node limit reached).
+*/
+
+#define PN_INF 100000000
+
+// a + b, saturating at PN_INF
+int pn_add(int a, int b)
+{
+	return a >= PN_INF - b ? PN_INF : a + b;
+}
+
+class PNNode
+{
+public:
+	Move move; // move leading to the node
+	int parent, first, count; // index of the parent and of the children (count is -1 until expanded)
+	int pn, dn;
+	int depth; // plies from the root; even for the attacker to move
+};
+
+class PNSolver
+{
+public:
+	int n;				   // mate in n moves
+	uint64_t limit, nodes; // nodes = positions generated
+	vector<PNNode> tree;
+	PNSolver(int moves, uint64_t max_nodes) : n(moves), limit(max_nodes), nodes(0) {}
+	void evaluate(Chessboard &c, PNNode &node);
+	void expand(Chessboard &c, int i);
+	void update(int i);
+	int solve(Chessboard &c, vector<Move> &line);
+};
+
+void PNSolver::evaluate(Chessboard &c, PNNode &node)
+// set the numbers of a new node, whose position is on c
+{
+	nodes++;
+	vector<Move> list;
+	c.legal_moves(list);
+	node.count = -1;
+	node.pn = node.dn = 1;
+	if (node.depth % 2 == 1) // defender to move
+	{
+		if (list.size() == 0)
+		{
+			if (c.attacked(c.turn))
+				node.pn = 0, node.dn = PN_INF; // mate
+			else
+				node.pn = PN_INF, node.dn = 0; // stalemate
+		}
+		else if (node.depth >= 2 * n - 1)
+			node.pn = PN_INF, node.dn = 0; // no attacker move left
+		else
+			node.pn = list.size(); // every defence has to be refuted
+	}
+	else if (list.size() == 0)
+		node.pn = PN_INF, node.dn = 0; // the attacker cannot move
+}
+
+void PNSolver::expand(Chessboard &c, int i) // create the children of node i, whose position is on c
+{
+	vector<Move> list;
+	c.legal_moves(list);
+	tree[i].first = tree.size();
+	tree[i].count = list.size();
+	for (int j = 0; j < list.size(); j++)
+	{
+		PNNode child;
+		child.move = list[j];
+		child.parent = i;
+		child.depth = tree[i].depth + 1;
+		c.make(list[j]);
+		evaluate(c, child);
+		c.unmake();
+		tree.push_back(child);
+	}
+}
+
+void PNSolver::update(int i) // recompute the numbers of node i from its children
+{
+	PNNode &node = tree[i];
+	int attacker = node.depth % 2 == 0;
+	int pn = attacker ? PN_INF : 0, dn = attacker ? 0 : PN_INF;
+	for (int j = node.first; j < node.first + node.count; j++)
+		if (attacker)
+		{
+			pn = min(pn, tree[j].pn);
+			dn = pn_add(dn, tree[j].dn);
+		}
+		else
+		{
+			pn = pn_add(pn, tree[j].pn);
+			dn = min(dn, tree[j].dn);
+		}
+	node.pn = pn;
+	node.dn = dn;
+}
+
+int PNSolver::solve(Chessboard &c, vector<Move> &line)
+{
+	tree.clear();
+	line.clear();
+	nodes = 0;
+	PNNode root;
+	root.parent = -1;
+	root.depth = 0;
+	evaluate(c, root);
+	tree.push_back(root);
+	while (tree[0].pn != 0 && tree[0].dn != 0 && nodes < limit)
+	{
+		// walk down to the most-proving node
+		int i = 0, made = 0;
+		while (tree[i].count != -1)
+		{
+			int best = -1;
+			for (int j = tree[i].first; j < tree[i].first + tree[i].count; j++)
+				if (best == -1 || (tree[i].depth % 2 == 0 ? tree[j].pn < tree[best].pn : tree[j].dn < tree[best].dn))
+					best = j;
+			i = best;
+			c.make(tree[i].move);
+			made++;
+		}
+		expand(c, i);
+		for (; made > 0; made--)
+			c.unmake();
+		// and back up to the root
+		for (; i != -1; i = tree[i].parent)
+			update(i);
+	}
+	if (tree[0].pn != 0)
+		return tree[0].dn == 0 ? 0 : -1;
+
+	// plies to mate of every proved node in the proof tree (children come after their parent)
+	vector<int> mate(tree.size(), -1);
+	for (int i = tree.size() - 1; i >= 0; i--)
+	{
+		if (tree[i].pn != 0)
+			continue;
+		if (tree[i].count <= 0)
+			mate[i] = 0;
+		for (int j = tree[i].first; j < tree[i].first + tree[i].count; j++)
+			if (tree[j].pn == 0 && (mate[i] == -1 || (tree[i].depth % 2 == 0 ? mate[j] + 1 < mate[i] : mate[j] + 1 > mate[i])))
+				mate[i] = mate[j] + 1;
+	}
+
+	// main line : the quickest mate for the attacker, the defence that delays it the longest
+	for (int i = 0; tree[i].count > 0;)
+	{
+		int best = -1;
+		for (int j = tree[i].first; j < tree[i].first + tree[i].count; j++)
+			if (tree[j].pn == 0 && (best == -1 || (tree[i].depth % 2 == 0 ? mate[j] < mate[best] : mate[j] > mate[best])))
+				best = j;
+		line.push_back(tree[best].move);
+		i = best;
+	}
+	return 1;
+}
+
+struct DFPNEntry
+{
+	uint64_t key; // position key mixed with the remaining plies
+	int pn, dn;
+	uint64_t work; // nodes spent on the entry, the smallest is replaced first
+};
+
+class DFPNSolver
+{
+public:
+	int n;
+	uint64_t limit, nodes;
+	vector<DFPNEntry> table; // buckets of 2 entries
+	DFPNSolver(int moves, uint64_t max_nodes, int hash_mb);
+	uint64_t entry_key(Chessboard &c, int depth);
+	DFPNEntry *probe(uint64_t key);
+	void store(uint64_t key, int pn, int dn, uint64_t work);
+	void lookup(Chessboard &c, int depth, int &pn, int &dn);
+	void mid(Chessboard &c, int depth, int thpn, int thdn);
+	int solve(Chessboard &c, vector<Move> &line);
+};
+
+DFPNSolver::DFPNSolver(int moves, uint64_t max_nodes, int hash_mb) : n(moves), limit(max_nodes), nodes(0)
+{
+	size_t entries = 2;
+	while (entries * 2 * sizeof(DFPNEntry) <= (size_t)hash_mb << 20)
+		entries *= 2;
+	table.assign(entries, DFPNEntry());
+}
+
+uint64_t DFPNSolver::entry_key(Chessboard &c, int depth)
+// proving a mate depends on the plies left, so they are part of the key
+{
+	return c.key() ^ ((uint64_t)(2 * n - depth) * 0x9E3779B97F4A7C15ULL);
+}
+
+DFPNEntry *DFPNSolver::probe(uint64_t key)
+{
+	DFPNEntry *b = &table[key & (table.size() - 2)];
+	if (b[0].key == key)
+		return &b[0];
+	if (b[1].key == key)
+		return &b[1];
+	return NULL;
+}
+
+void DFPNSolver::store(uint64_t key, int pn, int dn, uint64_t work)
+{
+	DFPNEntry *e = probe(key);
+	if (e == NULL)
+	{
+		DFPNEntry *b = &table[key & (table.size() - 2)];
+		e = b[0].work <= b[1].work ? &b[0] : &b[1];
+	}
+	e->key = key;
+	e->pn = pn;
+	e->dn = dn;
+	e->work = work;
+}
+
+void DFPNSolver::lookup(Chessboard &c, int depth, int &pn, int &dn) // numbers of a child, 1 / 1 if unknown
+{
+	DFPNEntry *e = probe(entry_key(c, depth));
+	pn = e ? e->pn : 1;
+	dn = e ? e->dn : 1;
+}
+
+void DFPNSolver::mid(Chessboard &c, int depth, int thpn, int thdn)
+// search the position on c until its proof number reaches thpn or its disproof number thdn
+{
+	uint64_t key = entry_key(c, depth), start = nodes;
+	nodes++;
+	int attacker = depth % 2 == 0;
+	vector<Move> list;
+	c.legal_moves(list);
+	if (list.size() == 0 || (!attacker && depth >= 2 * n - 1))
+	{
+		int mate = list.size() == 0 && !attacker && c.attacked(c.turn);
+		store(key, mate ? 0 : PN_INF, mate ? PN_INF : 0, 1);
+		return;
+	}
+
+	for (;;)
+	{
+		int pn = attacker ? PN_INF : 0, dn = attacker ? 0 : PN_INF;
+		int best = -1, best_pn = 0, best_dn = 0, second = PN_INF;
+		for (int i = 0; i < list.size(); i++)
+		{
+			int cpn, cdn;
+			c.make(list[i]);
+			lookup(c, depth + 1, cpn, cdn);
+			c.unmake();
+			int v = attacker ? cpn : cdn; // the number to minimise
+			if (best == -1 || v < (attacker ? best_pn : best_dn))
+			{
+				if (best != -1)
+					second = attacker ? best_pn : best_dn;
+				best = i;
+				best_pn = cpn;
+				best_dn = cdn;
+			}
+			else if (v < second)
+				second = v;
+			if (attacker)
+			{
+				pn = min(pn, cpn);
+				dn = pn_add(dn, cdn);
+			}
+			else
+			{
+				pn = pn_add(pn, cpn);
+				dn = min(dn, cdn);
+			}
+		}
+		if (pn >= thpn || dn >= thdn || nodes >= limit)
+		{
+			store(key, pn, dn, nodes - start);
+			return;
+		}
+		int cthpn, cthdn;
+		if (attacker)
+		{
+			cthpn = min(thpn, pn_add(second, 1));
+			cthdn = pn_add(thdn - dn, best_dn);
+		}
+		else
+		{
+			cthpn = pn_add(thpn - pn, best_pn);
+			cthdn = min(thdn, pn_add(second, 1));
+		}
+		c.make(list[best]);
+		mid(c, depth + 1, cthpn, cthdn);
+		c.unmake();
+	}
+}
+
+int DFPNSolver::solve(Chessboard &c, vector<Move> &line)
+{
+	line.clear();
+	nodes = 0;
+	mid(c, 0, PN_INF, PN_INF);
+	int pn, dn;
+	lookup(c, 0, pn, dn);
+	if (pn != 0)
+		return dn == 0 ? 0 : -1;
+
+	// main line, as far as the table still holds the proof
+	int depth = 0;
+	for (;;)
+	{
+		vector<Move> list;
+		c.legal_moves(list);
+		int best = -1;
+		for (int i = 0; i < list.size() && best == -1; i++)
+		{
+			int cpn, cdn;
+			c.make(list[i]);
+			lookup(c, depth + 1, cpn, cdn);
+			c.unmake();
+			if (cpn == 0)
+				best = i;
+		}
+		if (best == -1)
+			break;
+		line.push_back(list[best]);
+		c.make(list[best]);
+		depth++;
+	}
+	for (int i = 0; i < depth; i++)
+		c.unmake();
+	return 1;
+}
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef POSINDEX_CPP
+#define POSINDEX_CPP
+
+#include "chess.cpp"
+#include "archive.cpp"
+#include <algorithm>
+#include <queue>
+#include <thread>
+
+/*	Position index : finds the games of an archive that went through a position.
+
+	The index file holds the Zobrist key of every position of every game, sorted by key:
+
+		IndexHeader | Bloom filter (bloom_bits bits) | IndexEntry[entries]
+
+	A query first tests the Bloom filter, so most positions that were never played are rejected
+	without touching the entries, and otherwise does a binary search in the mapped entries.
+*/
+
+#define INDEX_MAGIC "CGI1"
+#define INDEX_VERSION 1
+#define BLOOM_BITS_PER_KEY 10
+#define BLOOM_HASHES 7
+#define MERGE_BUFFER (1 << 16) // Entries written at a time by build_index
+
+struct IndexHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t entries;
+	uint64_t bloom_bits;
+	uint64_t bloom_offset;	 // Position of the Bloom filter in the file
+	uint64_t entries_offset; // Position of the IndexEntry table in the file
+};
+
+struct IndexEntry
+{
+	uint64_t key;
+	uint32_t game; // Number of the game in the archive
+	uint32_t ply;  // First ply at which the game reached the position
+};
+
+bool operator<(const IndexEntry &a, const IndexEntry &b)
+{
+	if (a.key != b.key)
+		return a.key < b.key;
+	if (a.game != b.game)
+		return a.game < b.game;
+	return a.ply < b.ply;
+}
+
+// Bit of the Bloom filter used by hash function i for a key (double hashing)
+uint64_t bloom_bit(uint64_t key, int i, uint64_t bits)
+{
+	uint64_t h2 = ((key >> 33) ^ (key * 0xFF51AFD7ED558CCDULL)) | 1;
+	return (key + i * h2) % bits;
+}
+
+// Key of every position of the games [first, last) of the archive, sorted
+void collect_keys(ArchiveReader *in, uint64_t first, uint64_t last, vector<IndexEntry> *out)
+{
+	Chessboard c;
+	vector<Move> list;
+	for (uint64_t g = first; g < last; g++)
+	{
+		int plies, result;
+		const unsigned char *moves = in->game(g, plies, result);
+		if (moves == NULL)
+			continue;
+		c.newgame();
+		for (int i = 0;; i++)
+		{
+			IndexEntry e = {c.key(), (uint32_t)g, (uint32_t)i};
+			out->push_back(e);
+			if (i == plies)
+				break;
+			c.legal_moves(list);
+			if (moves[i] >= list.size())
+				break; // corrupt game, index the moves read so far
+			c.play(list[moves[i]]);
+		}
+	}
+	sort(out->begin(), out->end());
+}
+
+// Index all games of an archive, replaying them on "threads" threads. Returns 0 on failure
+int build_index(const char *archive_path, const char *index_path, int threads)
+{
+	ArchiveReader in;
+	if (!in.open(archive_path))
+		return 0;
+	if (threads < 1)
+		threads = 1;
+
+	// Every thread replays a slice of the archive and sorts its own keys
+	vector<vector<IndexEntry> > parts(threads);
+	vector<thread> workers;
+	uint64_t games = in.size();
+	for (int t = 0; t < threads; t++)
+		workers.push_back(thread(collect_keys, &in, games * t / threads, games * (t + 1) / threads, &parts[t]));
+	for (int t = 0; t < threads; t++)
+		workers[t].join();
+
+	// The filter is sized for every key collected : repetitions dropped below only make it a little larger
+	size_t total = 0;
+	for (int t = 0; t < threads; t++)
+		total += parts[t].size();
+	IndexHeader head;
+	memcpy(head.magic, INDEX_MAGIC, 4);
+	head.version = INDEX_VERSION;
+	head.bloom_bits = (total * BLOOM_BITS_PER_KEY + 63) / 64 * 64;
+	if (head.bloom_bits == 0)
+		head.bloom_bits = 64;
+	head.bloom_offset = sizeof(IndexHeader);
+	head.entries_offset = head.bloom_offset + head.bloom_bits / 8;
+	vector<uint64_t> bloom(head.bloom_bits / 64, 0);
+
+	FILE *fp = fopen(index_path, "wb");
+	if (fp == NULL)
+		return 0;
+	fseek(fp, head.entries_offset, SEEK_SET);
+
+	// Merge the parts in a single pass (a heap of their next entries) straight into the file
+	priority_queue<pair<IndexEntry, int>, vector<pair<IndexEntry, int> >, greater<pair<IndexEntry, int> > > heap;
+	vector<size_t> next(threads, 0);
+	for (int t = 0; t < threads; t++)
+		if (parts[t].size() != 0)
+			heap.push(make_pair(parts[t][0], t));
+	vector<IndexEntry> buffer;
+	IndexEntry last;
+	size_t n = 0;
+	int ok = 1;
+	while (!heap.empty())
+	{
+		IndexEntry e = heap.top().first;
+		int t = heap.top().second;
+		heap.pop();
+		if (++next[t] < parts[t].size())
+			heap.push(make_pair(parts[t][next[t]], t));
+		else
+			vector<IndexEntry>().swap(parts[t]);
+		// Keep the first ply at which a game reached a position (repetitions)
+		if (n != 0 && e.key == last.key && e.game == last.game)
+			continue;
+		last = e;
+		n++;
+		for (int j = 0; j < BLOOM_HASHES; j++)
+		{
+			uint64_t b = bloom_bit(e.key, j, head.bloom_bits);
+			bloom[b / 64] |= 1ULL << (b % 64);
+		}
+		buffer.push_back(e);
+		if (buffer.size() == MERGE_BUFFER)
+		{
+			if (fwrite(&buffer[0], sizeof(IndexEntry), buffer.size(), fp) != buffer.size())
+				ok = 0;
+			buffer.clear();
+		}
+	}
+	if (buffer.size() != 0 && fwrite(&buffer[0], sizeof(IndexEntry), buffer.size(), fp) != buffer.size())
+		ok = 0;
+
+	head.entries = n;
+	fseek(fp, 0, SEEK_SET);
+	if (fwrite(&head, sizeof(head), 1, fp) != 1 || fwrite(&bloom[0], 8, bloom.size(), fp) != bloom.size())
+		ok = 0;
+	if (fclose(fp) != 0)
+		ok = 0;
+	return ok;
+}
+
+class PositionIndex // Read-only access to an index file mapped in memory
+{
+public:
+	const unsigned char *data;
+	size_t length;
+	const IndexHeader *head;
+	const uint64_t *bloom;
+	const IndexEntry *entries;
+	PositionIndex() { data = NULL; }
+	~PositionIndex() { close(); }
+	int open(const char *path);
+	void close();
+	int maybe_contains(uint64_t key);
+	// Games which reached the position with the given key
+	void lookup(uint64_t key, vector<IndexEntry> &out);
+};
+
+int PositionIndex::open(const char *path)
+{
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(IndexHeader))
+	{
+		::close(fd);
+		return 0;
+	}
+	void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		return 0;
+	data = (const unsigned char *)p;
+	length = st.st_size;
+	head = (const IndexHeader *)data;
+	if (memcmp(head->magic, INDEX_MAGIC, 4) != 0 || head->version != INDEX_VERSION || head->bloom_bits == 0 ||
+		head->entries_offset > length || (length - head->entries_offset) / sizeof(IndexEntry) < head->entries ||
+		head->bloom_offset + head->bloom_bits / 8 > head->entries_offset)
+	{
+		close();
+		return 0;
+	}
+	bloom = (const uint64_t *)(data + head->bloom_offset);
+	entries = (const IndexEntry *)(data + head->entries_offset);
+	return 1;
+}
+
+void PositionIndex::close()
+{
+	if (data != NULL)
+		munmap((void *)data, length);
+	data = NULL;
+}
+
+int PositionIndex::maybe_contains(uint64_t key) // 0 if the position is certainly not in the index
+{
+	if (data == NULL)
+		return 0;
+	for (int j = 0; j < BLOOM_HASHES; j++)
+	{
+		uint64_t b = bloom_bit(key, j, head->bloom_bits);
+		if (!(bloom[b / 64] & (1ULL << (b % 64))))
+			return 0;
+	}
+	return 1;
+}
+
+void PositionIndex::lookup(uint64_t key, vector<IndexEntry> &out)
+{
+	out.clear();
+	if (!maybe_contains(key))
+		return;
+	IndexEntry e = {key, 0, 0};
+	const IndexEntry *end = entries + head->entries;
+	for (const IndexEntry *i = lower_bound(entries, end, e); i != end && i->key == key; i++)
+		out.push_back(*i);
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef REPLAY_CPP
+#define REPLAY_CPP
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+using namespace std;
+
+/*	Recording and replay of UI input, to measure how fast the UI answers.
+
+	With --record <file> every accepted click and menu choice is written to the file, one per line,
+	with the time since the start in milliseconds :
+
+		1523.250 mouse 412 288
+		4810.000 menu 1
+		5102.500 menu 11 42
+
+	A menu event may carry a value, such as the ply of a jump.
+
+	With --replay <file> the events are fed to the UI again at the same times. After each one the
+	UI waits for the frame to be drawn (glFinish) and the time from the event to that point is kept.
+	Every frame drawn while an event is handled (each display()) is also waited for, and its time,
+	from the event or the previous frame, is kept. Percentiles of both are printed when the last
+	event has been handled. Run with LIBGL_ALWAYS_SOFTWARE=1
+	to measure with the software GL driver.
+*/
+
+#define EVENT_MOUSE 0
+#define EVENT_MENU 1
+
+class InputEvent
+{
+public:
+	double t; // milliseconds since the start
+	int type;
+	int x, y; // window position for a click, menu id in x and its value in y for a menu choice
+};
+
+class InputLog
+{
+public:
+	FILE *fp; // file being recorded, NULL if not recording
+	chrono::steady_clock::time_point start;
+	vector<InputEvent> events; // events to replay
+	vector<double> latency;	   // milliseconds from each replayed event to its frame
+	vector<double> frame_times; // milliseconds taken by each frame drawn for a replayed event
+	double last_frame;			// time of the event or of its last frame, -1 between events
+	InputLog();
+	~InputLog();
+	double now();
+	int record(const char *path);
+	void log(int type, int x, int y);
+	int load(const char *path);
+	void frame();
+	void report(FILE *out);
+};
+
+InputLog::InputLog()
+{
+	fp = NULL;
+	last_frame = -1;
+	start = chrono::steady_clock::now();
+}
+
+InputLog::~InputLog()
+{
+	if (fp != NULL)
+		fclose(fp);
+}
+
+double InputLog::now() // milliseconds since the start (or since the last call to record or load)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int InputLog::record(const char *path)
+{
+	fp = fopen(path, "w");
+	start = chrono::steady_clock::now();
+	return fp != NULL;
+}
+
+void InputLog::log(int type, int x, int y)
+{
+	if (fp == NULL)
+		return;
+	if (type == EVENT_MOUSE)
+		fprintf(fp, "%.3f mouse %d %d\n", now(), x, y);
+	else if (y != 0)
+		fprintf(fp, "%.3f menu %d %d\n", now(), x, y);
+	else
+		fprintf(fp, "%.3f menu %d\n", now(), x);
+	fflush(fp); // the UI is usually left by closing the window
+}
+
+int InputLog::load(const char *path)
+{
+	FILE *in = fopen(path, "r");
+	if (in == NULL)
+		return 0;
+	char line[128], type[16];
+	events.clear();
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		InputEvent e;
+		e.y = 0;
+		int n = sscanf(line, "%lf %15s %d %d", &e.t, type, &e.x, &e.y);
+		if (n >= 4 && strcmp(type, "mouse") == 0)
+			e.type = EVENT_MOUSE;
+		else if (n >= 3 && strcmp(type, "menu") == 0)
+			e.type = EVENT_MENU;
+		else
+			continue;
+		events.push_back(e);
+	}
+	fclose(in);
+	stable_sort(events.begin(), events.end(), [](const InputEvent &a, const InputEvent &b) { return a.t < b.t; });
+	start = chrono::steady_clock::now();
+	return 1;
+}
+
+void InputLog::frame() // a frame was drawn (and waited for) during a replayed event
+{
+	if (last_frame < 0)
+		return;
+	double t = now();
+	frame_times.push_back(t - last_frame);
+	last_frame = t;
+}
+
+void print_percentiles(FILE *out, const char *name, vector<double> v)
+{
+	if (v.size() == 0)
+		return;
+	sort(v.begin(), v.end());
+	double sum = 0;
+	for (int i = 0; i < v.size(); i++)
+		sum += v[i];
+	const int p[] = {50, 95, 99};
+	fprintf(out, "%s (ms): mean %.3f", name, sum / v.size());
+	for (int i = 0; i < 3; i++)
+		fprintf(out, "  p%d %.3f", p[i], v[min(v.size() - 1, (size_t)(v.size() * p[i] / 100))]);
+	fprintf(out, "  max %.3f\n", v.back());
+}
+
+void InputLog::report(FILE *out) // percentiles of the latencies and frame times measured during a replay
+{
+	fprintf(out, "%d events replayed, %d frames\n", (int)latency.size(), (int)frame_times.size());
+	print_percentiles(out, "event to frame", latency);
+	print_percentiles(out, "frame time", frame_times);
+}
+
+#endif
@@ -0,0 +1,384 @@
+#ifndef SCHEDULER_CPP
+#define SCHEDULER_CPP
+
+#include "engine.cpp"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/*	Analysis of many positions on a fixed pool of threads.
+
+	Jobs are submitted as a FEN, a priority and limits. Their results are passed to a callback,
+	called from a worker thread, or queued for next_result(). Every worker searches with its own
+	Engine on its own Chessboard, so jobs share nothing with the UI or with each other.
+
+	A job is a resumable task : an iterative deepening search whose completed iterations are kept
+	with the job. The engine checks its stop flag every 1024 nodes. When a job is submitted and the
+	free workers cannot take every queued job of its priority or higher (a worker that was woken may
+	not have taken its job yet), the worker running the job of lowest priority below it is stopped
+	there and its job goes back to the front of the queue of its priority. It later resumes on any
+	worker from the next depth, so only the interrupted iteration is searched again. Bulk jobs (low
+	priority) thus fill the idle workers and give them up within milliseconds; jobs of the same
+	priority run in the order they were submitted. Every priority has its own FIFO, so queuing a
+	job does not depend on how many others wait. A producer of many bulk jobs should call
+	wait_pending() before each one, so that only a few wait at a time.
+*/
+
+#define ANALYSIS_DONE 0		 // a limit was reached, or the position is decided
+#define ANALYSIS_INVALID 1	 // the FEN could not be read
+#define ANALYSIS_CANCELLED 2 // cancel() was called
+
+class AnalysisLimits // 0 for no limit, but a job needs at least one
+{
+public:
+	int depth;
+	uint64_t nodes;
+	double ms; // search time, not counting the time spent waiting in the queue
+	AnalysisLimits(int d = 0, uint64_t n = 0, double t = 0) : depth(d), nodes(n), ms(t) {}
+};
+
+class AnalysisResult
+{
+public:
+	int id;
+	int status;
+	int depth; // last completed iteration, 0 if none
+	int score; // for the player to move
+	Move best;
+	vector<Move> pv;
+	uint64_t nodes;
+	double ms;		// search time
+	double wait_ms; // time from submission to the start of the search
+	int slices;		// times the job was given a worker, more than 1 if it was preempted
+};
+
+class AnalysisJob
+{
+public:
+	int id, priority;
+	char fen[100];
+	AnalysisLimits limits;
+	void (*callback)(const AnalysisResult &, void *);
+	void *data;
+	int cancelled;
+	chrono::steady_clock::time_point submitted;
+	AnalysisResult result; // progress so far
+};
+
+class AnalysisWorker
+{
+public:
+	Engine *engine; // set by the worker thread
+	AnalysisJob *job; // running job, NULL if idle
+	int yield;		  // 1 when the job was stopped to make room for another
+};
+
+class AnalysisScheduler
+{
+public:
+	mutex lock; // protects everything below
+	condition_variable wake, ready;
+	map<int, deque<AnalysisJob *> > queues; // jobs waiting, by priority. No queue is empty
+	int queued;
+	vector<AnalysisWorker> workers;
+	deque<AnalysisResult> results; // results of the jobs without callback
+	int next_id, pending;		   // pending counts the jobs queued or running
+	int closing;
+	EngineOptions opt;
+	vector<thread> threads;
+	AnalysisScheduler(int n, const EngineOptions &o = EngineOptions());
+	~AnalysisScheduler();
+	int submit(const char *fen, int priority, const AnalysisLimits &limits, void (*callback)(const AnalysisResult &, void *) = NULL, void *data = NULL);
+	void cancel(int id);
+	int next_result(AnalysisResult &r, int wait);
+	void wait();
+	void wait_pending(int n);
+	void work(int w);
+	int resume(Engine &e, Chessboard &c, AnalysisJob &job);
+	void finish(AnalysisJob *job);
+	void enqueue(AnalysisJob *job, int resumed);
+	AnalysisJob *dequeue();
+
+private:
+	AnalysisScheduler(const AnalysisScheduler &); // the workers point to it
+	AnalysisScheduler &operator=(const AnalysisScheduler &);
+};
+
+AnalysisScheduler::AnalysisScheduler(int n, const EngineOptions &o) : opt(o)
+{
+	next_id = pending = closing = queued = 0;
+	workers.resize(max(n, 1));
+	for (int i = 0; i < workers.size(); i++)
+	{
+		workers[i].engine = NULL;
+		workers[i].job = NULL;
+		workers[i].yield = 0;
+	}
+	for (int i = 0; i < workers.size(); i++)
+		threads.push_back(thread(&AnalysisScheduler::work, this, i));
+}
+
+AnalysisScheduler::~AnalysisScheduler() // stop the searches. Jobs not finished are dropped without a result
+{
+	{
+		lock_guard<mutex> guard(lock);
+		closing = 1;
+		for (int i = 0; i < workers.size(); i++)
+			if (workers[i].engine != NULL)
+				workers[i].engine->stop = 1;
+		wake.notify_all();
+	}
+	for (int i = 0; i < threads.size(); i++)
+		threads[i].join();
+	for (map<int, deque<AnalysisJob *> >::iterator q = queues.begin(); q != queues.end(); q++)
+		for (int i = 0; i < q->second.size(); i++)
+			delete q->second[i];
+}
+
+void AnalysisScheduler::enqueue(AnalysisJob *job, int resumed)
+// at the back of the queue of its priority, or at the front for a preempted job, which is older than
+// the jobs waiting. Lock held
+{
+	deque<AnalysisJob *> &q = queues[job->priority];
+	if (resumed)
+		q.push_front(job);
+	else
+		q.push_back(job);
+	queued++;
+}
+
+AnalysisJob *AnalysisScheduler::dequeue() // the next job of the highest priority. Lock held, queued != 0
+{
+	map<int, deque<AnalysisJob *> >::iterator q = --queues.end();
+	AnalysisJob *job = q->second.front();
+	q->second.pop_front();
+	if (q->second.empty())
+		queues.erase(q);
+	queued--;
+	return job;
+}
+
+int AnalysisScheduler::submit(const char *fen, int priority, const AnalysisLimits &limits, void (*callback)(const AnalysisResult &, void *), void *data)
+// queue the analysis of a position. Higher priorities run first. Returns the id of the job, or -1 if
+// it has no limit
+{
+	if (limits.depth <= 0 && limits.nodes == 0 && limits.ms <= 0)
+		return -1;
+	AnalysisJob *job = new AnalysisJob;
+	strncpy(job->fen, fen, sizeof(job->fen) - 1);
+	job->fen[sizeof(job->fen) - 1] = '\0';
+	job->priority = priority;
+	job->limits = limits;
+	job->callback = callback;
+	job->data = data;
+	job->cancelled = 0;
+	job->submitted = chrono::steady_clock::now();
+	AnalysisResult &r = job->result;
+	r.status = ANALYSIS_DONE;
+	r.depth = r.score = r.slices = 0;
+	r.best = Move(9, 9, 9, 9);
+	r.nodes = 0;
+	r.ms = r.wait_ms = 0;
+
+	lock_guard<mutex> guard(lock);
+	job->id = r.id = next_id++;
+	pending++;
+	enqueue(job, 0);
+	// the free workers, and those already stopping, go to the queued jobs of this priority or higher.
+	// If there are more of these jobs, the worker running the job of lowest priority below this one makes room
+	int waiting = 0, idle = 0;
+	for (map<int, deque<AnalysisJob *> >::iterator q = queues.lower_bound(priority); q != queues.end(); q++)
+		waiting += q->second.size();
+	AnalysisWorker *victim = NULL;
+	for (int i = 0; i < workers.size(); i++)
+	{
+		AnalysisWorker &w = workers[i];
+		if (w.job == NULL || w.yield)
+			idle++;
+		else if (w.job->priority < priority && (victim == NULL || w.job->priority < victim->job->priority))
+			victim = &w;
+	}
+	if (waiting > idle && victim != NULL)
+	{
+		victim->yield = 1;
+		victim->engine->stop = 1;
+	}
+	wake.notify_one();
+	return job->id;
+}
+
+void AnalysisScheduler::cancel(int id) // drop a job. Its result has the status ANALYSIS_CANCELLED
+{
+	AnalysisJob *job = NULL;
+	{
+		lock_guard<mutex> guard(lock);
+		for (int i = 0; i < workers.size(); i++)
+			if (workers[i].job != NULL && workers[i].job->id == id)
+			{
+				workers[i].job->cancelled = 1; // finished by its worker
+				workers[i].engine->stop = 1;
+				return;
+			}
+		for (map<int, deque<AnalysisJob *> >::iterator q = queues.begin(); q != queues.end() && job == NULL; q++)
+			for (int i = 0; i < q->second.size(); i++)
+				if (q->second[i]->id == id)
+				{
+					job = q->second[i];
+					q->second.erase(q->second.begin() + i);
+					queued--;
+					break;
+				}
+		if (job != NULL && queues[job->priority].empty())
+			queues.erase(job->priority);
+	}
+	if (job != NULL)
+	{
+		job->cancelled = 1;
+		finish(job);
+	}
+}
+
+void AnalysisScheduler::finish(AnalysisJob *job) // hand out the result of a job and delete it. Lock not held
+{
+	if (job->cancelled)
+		job->result.status = ANALYSIS_CANCELLED;
+	if (job->callback != NULL)
+		job->callback(job->result, job->data);
+	lock_guard<mutex> guard(lock);
+	if (job->callback == NULL)
+		results.push_back(job->result);
+	pending--;
+	ready.notify_all();
+	delete job;
+}
+
+int AnalysisScheduler::next_result(AnalysisResult &r, int wait)
+// take the oldest result of the jobs submitted without callback, waiting for one if "wait" is 1.
+// Returns 0 if there is none, and with wait = 1 only when no job is left to give one
+{
+	unique_lock<mutex> guard(lock);
+	while (wait && results.empty() && pending != 0)
+		ready.wait(guard);
+	if (results.empty())
+		return 0;
+	r = results.front();
+	results.pop_front();
+	return 1;
+}
+
+void AnalysisScheduler::wait() // until every job submitted so far has given its result
+{
+	unique_lock<mutex> guard(lock);
+	while (pending != 0)
+		ready.wait(guard);
+}
+
+void AnalysisScheduler::wait_pending(int n) // until fewer than n jobs are queued or running
+{
+	unique_lock<mutex> guard(lock);
+	while (pending >= n)
+		ready.wait(guard);
+}
+
+int AnalysisScheduler::resume(Engine &e, Chessboard &c, AnalysisJob &job)
+// search the job from its next depth until a limit is reached or the worker is stopped. Returns 1
+// if the job is complete
+{
+	AnalysisResult &r = job.result;
+	AnalysisLimits &l = job.limits;
+	if (!c.setup(job.fen))
+	{
+		r.status = ANALYSIS_INVALID;
+		return 1;
+	}
+	vector<Move> list;
+	c.legal_moves(list);
+	if (list.size() == 0)
+	{
+		r.score = c.attacked(c.turn) ? -MATE : 0;
+		return 1;
+	}
+	if (r.best.x == 9)
+		r.best = list[0];
+	if ((l.nodes != 0 && r.nodes >= l.nodes) || (l.ms > 0 && r.ms >= l.ms))
+		return 1;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	e.deadline = l.ms > 0 ? start + chrono::microseconds((long long)((l.ms - r.ms) * 1000)) : chrono::steady_clock::time_point::max();
+	e.node_limit = l.nodes != 0 ? e.nodes + (l.nodes - r.nodes) : 0;
+	e.history.clear();
+	uint64_t before = e.nodes;
+	int complete = 0;
+	for (int d = r.depth + 1; !complete; d++)
+	{
+		if ((l.depth > 0 && d > l.depth) || d >= MAX_PLY)
+		{
+			complete = 1;
+			break;
+		}
+		if (!e.deepen(c, d, r.score, r.best))
+			break;
+		r.depth = d;
+		e.principal_variation(c, r.best, d, r.pv);
+		if (r.score > MATE - MAX_PLY || r.score < -MATE + MAX_PLY || list.size() == 1)
+			complete = 1; // nothing more to find
+	}
+	r.nodes += e.nodes - before;
+	r.ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	e.node_limit = 0;
+	return complete;
+}
+
+void AnalysisScheduler::work(int w)
+{
+	Engine e(opt);
+	Chessboard c;
+	{
+		lock_guard<mutex> guard(lock);
+		workers[w].engine = &e;
+	}
+	for (;;)
+	{
+		AnalysisJob *job;
+		{
+			unique_lock<mutex> guard(lock);
+			while (!closing && queued == 0)
+				wake.wait(guard);
+			if (closing)
+			{
+				workers[w].engine = NULL;
+				return;
+			}
+			job = dequeue();
+			workers[w].job = job;
+			workers[w].yield = 0;
+			e.stop = 0; // set again by submit(), cancel() or the destructor after this
+		}
+		if (job->result.slices++ == 0)
+			job->result.wait_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - job->submitted).count();
+		int complete = resume(e, c, *job);
+		{
+			lock_guard<mutex> guard(lock);
+			// a search stopped by the job's own limits is complete too
+			complete |= job->cancelled || !workers[w].yield;
+			workers[w].job = NULL;
+			if (closing)
+			{
+				workers[w].engine = NULL;
+				delete job;
+				return;
+			}
+			if (!complete)
+			{
+				enqueue(job, 1);
+				wake.notify_one();
+			}
+		}
+		if (complete)
+			finish(job);
+	}
+}
+
+#endif
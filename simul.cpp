@@ -0,0 +1,258 @@
+#include <GL/glut.h>
+#include "boardgrid.cpp"
+#include "engine.cpp"
+#include <mutex>
+#include <random>
+#include <thread>
+
+/*	Simultaneous exhibition : live engine games in one resizable window.
+
+		simul [-boards n] [-threads n] [-engine settings] [-ms n] [-bench frames]
+
+	-boards games (default 64) are played by -threads threads (default all cores), each thread
+	making one move in each of its games in turn, with -engine settings (as in EngineOptions::parse)
+	and -ms milliseconds per move. The first plies of a game are random, so the games differ, and a
+	finished game stays on its board for SIMUL_PAUSE_MS before a new one starts there.
+
+	The boards are drawn by a BoardGrid (see boardgrid.cpp) SIMUL_FPS times a second : the games
+	publish their positions, and only the boards that changed since the last frame are drawn. The
+	time taken per board is measured, and a frame draws no more boards than fit in SIMUL_BUDGET of
+	it; after a resize the boards thus fill in over a few frames instead of stalling them. The
+	title shows the frame rate and the boards drawn per frame. -bench n plays no game but draws every
+	board on every frame, as fast as it can, for n frames and prints the frame rate, to check a GL
+	driver (LIBGL_ALWAYS_SOFTWARE=1 selects Mesa's software one).
+*/
+
+#define SIMUL_FPS 60
+#define SIMUL_BUDGET 0.6 // Share of a frame spent drawing
+#define SIMUL_PAUSE_MS 3000
+#define SIMUL_RANDOM_PLIES 8
+
+class LiveGames // Games played on threads, and their positions for the window
+{
+public:
+	int count;
+	EngineOptions opt;
+	double ms;
+	mutex lock; // protects states
+	vector<BoardState> states;
+	LiveGames(int n);
+	void worker(int id, int threads);
+	int play(Chessboard &c, Engine &e, vector<uint64_t> &keys, mt19937_64 &rng, Move &m);
+};
+
+LiveGames::LiveGames(int n)
+{
+	count = n;
+	ms = 100;
+	states.resize(n);
+}
+
+int LiveGames::play(Chessboard &c, Engine &e, vector<uint64_t> &keys, mt19937_64 &rng, Move &m)
+// make the next move of a game in m. Returns its result, RESULT_UNKNOWN if it goes on
+{
+	vector<Move> list;
+	keys.push_back(c.key());
+	int result = adjudicate(c, keys, keys.size() - 1);
+	if (result != RESULT_UNKNOWN)
+		return result;
+	if (keys.size() <= SIMUL_RANDOM_PLIES)
+	{
+		c.legal_moves(list);
+		m = list[rng() % list.size()];
+	}
+	else
+	{
+		int score, depth;
+		e.history = keys;
+		e.history.pop_back();
+		m = e.think(c, ms, score, depth);
+	}
+	c.make(m);
+	return RESULT_UNKNOWN;
+}
+
+void LiveGames::worker(int id, int threads) // play the games id, id + threads, ... one move at a time
+{
+	Engine e(opt);
+	mt19937_64 rng(0x5140000ULL + id);
+	vector<Chessboard *> boards;
+	vector<vector<uint64_t> > keys;
+	vector<int> games, results;
+	vector<chrono::steady_clock::time_point> ended;
+	for (int i = id; i < count; i += threads)
+	{
+		games.push_back(i);
+		boards.push_back(new Chessboard);
+	}
+	keys.resize(games.size());
+	results.assign(games.size(), RESULT_UNKNOWN);
+	ended.resize(games.size());
+	for (;;)
+	{
+		// when every game is paused, sleep until the first one restarts
+		chrono::steady_clock::time_point wake = chrono::steady_clock::time_point::max();
+		for (int i = 0; i < games.size(); i++)
+			if (results[i] == RESULT_UNKNOWN)
+				wake = chrono::steady_clock::time_point::min(); // a game goes on
+			else
+				wake = min(wake, ended[i] + chrono::milliseconds(SIMUL_PAUSE_MS));
+		this_thread::sleep_until(wake);
+		for (int i = 0; i < games.size(); i++)
+		{
+			Move m;
+			BoardState s;
+			if (results[i] != RESULT_UNKNOWN)
+			{
+				if (chrono::steady_clock::now() - ended[i] < chrono::milliseconds(SIMUL_PAUSE_MS))
+					continue;
+				delete boards[i];
+				boards[i] = new Chessboard; // a new game
+				keys[i].clear();
+				results[i] = RESULT_UNKNOWN;
+				s.set(*boards[i], NULL, RESULT_UNKNOWN);
+			}
+			else if ((results[i] = play(*boards[i], e, keys[i], rng, m)) == RESULT_UNKNOWN)
+				s.set(*boards[i], &m, RESULT_UNKNOWN);
+			else
+			{
+				ended[i] = chrono::steady_clock::now();
+				lock_guard<mutex> guard(lock);
+				states[games[i]].result = results[i];
+				continue;
+			}
+			lock_guard<mutex> guard(lock);
+			states[games[i]] = s;
+		}
+	}
+}
+
+LiveGames *games;
+BoardGrid *grid;
+int bench_frames = 0, frames = 0, boards_drawn = 0;
+double board_ms = 0; // Time to draw a board, measured
+chrono::steady_clock::time_point next_frame, counted; // Time of the next frame, start of the frame count
+
+void reshape(int w, int h)
+{
+	glViewport(0, 0, w, h);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	gluOrtho2D(0, w, 0, h);
+	glMatrixMode(GL_MODELVIEW);
+	grid->layout(w, h);
+}
+
+void display() // the window was exposed or resized : clear it, the next frame draws every board
+{
+	glClear(GL_COLOR_BUFFER_BIT);
+	grid->redraw_all();
+	glFlush();
+}
+
+// Draw the boards that changed, SIMUL_FPS times a second, and show the frame rate every second
+void frame(int v)
+{
+	if (bench_frames && frames == 0)
+		counted = chrono::steady_clock::now(); // the window is up
+	{
+		lock_guard<mutex> guard(games->lock);
+		for (int i = 0; i < games->count; i++)
+			grid->update(i, games->states[i]);
+	}
+	int limit = INT_MAX;
+	if (bench_frames)
+		grid->redraw_all();
+	else if (board_ms > 0)
+		limit = max(1, (int)(SIMUL_BUDGET * 1000 / SIMUL_FPS / board_ms));
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	int drawn = grid->draw(limit);
+	glFinish(); // so that the time measured is the drawing time
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (drawn != 0)
+	{
+		double ms = chrono::duration<double, milli>(now - begin).count() / drawn;
+		board_ms = board_ms == 0 ? ms : board_ms * 0.8 + ms * 0.2;
+	}
+	boards_drawn += drawn;
+	frames++;
+
+	double seconds = chrono::duration<double>(now - counted).count();
+	if (bench_frames && frames == bench_frames)
+	{
+		printf("%d boards, %dx%d : %d frames in %.2f s, %.1f fps\n", games->count, grid->width, grid->height, frames, seconds, frames / seconds);
+		exit(0);
+	}
+	if (!bench_frames && seconds >= 1)
+	{
+		char title[100];
+		sprintf(title, "SIMUL  %d BOARDS  %.0f FPS  %.1f BOARDS PER FRAME", games->count, frames / seconds, (double)boards_drawn / frames);
+		glutSetWindowTitle(title);
+		frames = boards_drawn = 0;
+		counted = now;
+	}
+	if (bench_frames)
+	{
+		glutTimerFunc(0, frame, 0);
+		return;
+	}
+	next_frame += chrono::microseconds(1000000 / SIMUL_FPS);
+	if (next_frame < now)
+		next_frame = now; // late, do not try to catch up
+	glutTimerFunc((unsigned)chrono::duration_cast<chrono::milliseconds>(next_frame - now).count(), frame, 0);
+}
+
+int main(int argc, char **argv)
+{
+	glutInit(&argc, argv);
+	int boards = 64, threads = max(1, (int)thread::hardware_concurrency());
+	EngineOptions opt;
+	double ms = 100;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		string o = argv[i];
+		const char *v = argv[i + 1];
+		int ok = 1;
+		if (o == "-boards")
+			ok = (boards = atoi(v)) > 0;
+		else if (o == "-threads")
+			threads = max(1, atoi(v));
+		else if (o == "-engine")
+			ok = opt.parse(v);
+		else if (o == "-ms")
+			ok = (ms = atof(v)) > 0;
+		else if (o == "-bench")
+			ok = (bench_frames = atoi(v)) > 0;
+		else
+			ok = 0;
+		if (!ok)
+		{
+			cerr << "invalid option " << o << " " << v << endl;
+			cerr << "usage: " << argv[0] << " [-boards n] [-threads n] [-engine settings] [-ms n] [-bench frames]" << endl;
+			return 1;
+		}
+	}
+
+	// the games and the grid are never deleted : the threads play until the program exits
+	games = new LiveGames(boards);
+	games->opt = opt;
+	games->ms = ms;
+	grid = new BoardGrid(boards);
+	Chessboard start;
+	for (int i = 0; i < boards; i++)
+		games->states[i].set(start, NULL, RESULT_UNKNOWN);
+	for (int i = 0; i < min(threads, boards) && !bench_frames; i++)
+		thread(&LiveGames::worker, games, i, min(threads, boards)).detach();
+
+	glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
+	glutInitWindowSize(1366, 685);
+	glutInitWindowPosition(0, 0);
+	glutCreateWindow("SIMUL");
+	glClearColor(0, 0, 0, 1);
+	glutDisplayFunc(display);
+	glutReshapeFunc(reshape);
+	next_frame = counted = chrono::steady_clock::now();
+	glutTimerFunc(0, frame, 0);
+	glutMainLoop();
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include "pns.cpp"
+#include "engine.cpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/*	Mate puzzle solver.
+
+	solver <file.epd> [-n moves] [-algo pns|dfpn] [-nodes limit] [-hash mb] [-threads n]
+
+	Every line of the file is a position in FEN (EPD lines work). The number of moves to mate is
+	read from a "dm <n>;" operation when there is one, and is -n (default 3) otherwise. Positions
+	are solved in parallel and reported in the order of the file.
+*/
+
+class Puzzle
+{
+public:
+	string fen;
+	int moves;
+	// results
+	int solved; // 1 mate, 0 no mate, -1 node limit, -2 invalid position
+	vector<Move> line;
+	uint64_t nodes;
+	double ms;
+};
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL, *algo = "dfpn";
+	int default_moves = 3, hash_mb = 64, threads = max(1, (int)thread::hardware_concurrency());
+	uint64_t limit = 10000000;
+	for (int i = 1; i < argc; i++)
+	{
+		string o = argv[i];
+		if (o[0] != '-')
+			path = argv[i];
+		else if (i + 1 == argc)
+			path = NULL;
+		else if (o == "-n")
+			default_moves = atoi(argv[++i]);
+		else if (o == "-algo")
+			algo = argv[++i];
+		else if (o == "-nodes")
+			limit = atoll(argv[++i]);
+		else if (o == "-hash")
+			hash_mb = atoi(argv[++i]);
+		else if (o == "-threads")
+			threads = max(1, atoi(argv[++i]));
+		else
+			path = NULL;
+	}
+	if (path == NULL || (strcmp(algo, "pns") != 0 && strcmp(algo, "dfpn") != 0))
+	{
+		cerr << "usage: " << argv[0] << " <file.epd> [-n moves] [-algo pns|dfpn] [-nodes limit] [-hash mb] [-threads n]" << endl;
+		return 1;
+	}
+
+	vector<Puzzle> puzzles;
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		cerr << "could not open " << path << endl;
+		return 1;
+	}
+	char buf[512];
+	while (fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		if (buf[0] == '#' || buf[0] == '\n')
+			continue;
+		Puzzle p;
+		p.fen = buf;
+		p.moves = default_moves;
+		const char *dm = strstr(buf, " dm ");
+		if (dm != NULL)
+			p.moves = atoi(dm + 4);
+		puzzles.push_back(p);
+	}
+	fclose(fp);
+
+	atomic<int> next(0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (int t = 0; t < threads; t++)
+		workers.push_back(thread([&]() {
+			// every thread has its own table, bounded by -hash. It is kept from one puzzle to the next :
+			// entries are keyed by position and plies left, so what they prove stays true
+			DFPNSolver dfpn(default_moves, limit, hash_mb);
+			for (int i = next++; i < puzzles.size(); i = next++)
+			{
+				Puzzle &p = puzzles[i];
+				Chessboard c;
+				chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+				if (!c.setup(p.fen.c_str()) || p.moves < 1)
+					p.solved = -2, p.nodes = 0;
+				else if (strcmp(algo, "pns") == 0)
+				{
+					PNSolver s(p.moves, limit);
+					p.solved = s.solve(c, p.line);
+					p.nodes = s.nodes;
+				}
+				else
+				{
+					dfpn.n = p.moves;
+					p.solved = dfpn.solve(c, p.line);
+					p.nodes = dfpn.nodes;
+				}
+				p.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+			}
+		}));
+	for (int t = 0; t < threads; t++)
+		workers[t].join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	int solved = 0;
+	uint64_t nodes = 0;
+	char name[5];
+	for (int i = 0; i < puzzles.size(); i++)
+	{
+		Puzzle &p = puzzles[i];
+		nodes += p.nodes;
+		cout << i + 1 << ": ";
+		if (p.solved == -2)
+			cout << "invalid position";
+		else if (p.solved == -1)
+			cout << "unsolved (node limit)";
+		else if (p.solved == 0)
+			cout << "no mate in " << p.moves;
+		else
+		{
+			solved++;
+			cout << "mate in " << (p.line.size() + 1) / 2 << ":";
+			for (int j = 0; j < p.line.size(); j++)
+			{
+				move_name(p.line[j], name);
+				cout << " " << name;
+			}
+		}
+		cout << "  (" << p.nodes << " nodes, " << p.ms << " ms)" << endl;
+	}
+	cout << solved << "/" << puzzles.size() << " mates found, " << nodes << " nodes, "
+		 << (seconds > 0 ? nodes / seconds : 0) << " nodes/s" << endl;
+	return 0;
+}
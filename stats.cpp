@@ -0,0 +1,197 @@
+#ifndef STATS_CPP
+#define STATS_CPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*	Engine counters and timers.
+
+	Built only with -DCHESS_STATS (make STATS=1). Otherwise the STAT_ macros expand to nothing and
+	stats_summary() / stats_json() report that statistics are disabled.
+
+	Every thread counts into its own block, so the hot paths never share a cache line or take a
+	lock. Blocks are linked in a global list when a thread first counts something and are never
+	freed, so the totals still include threads that have finished.
+
+	If the environment variable CHESS_STATS_JSON names a file, a JSON snapshot is written there
+	when the program exits.
+*/
+
+enum StatCounter
+{
+	STAT_CHECKMOVE,		  // Piece::checkmove calls (a Queen counts twice, as a Rook and a Bishop)
+	STAT_CHECK,			  // Chessboard::check scans
+	STAT_ATTACKED,		  // Chessboard::attacked scans
+	STAT_CHECKMATE_TRIAL, // moves tried by Chessboard::checkmate
+	STAT_MOVE,			  // moves made by Chessboard::move
+	STAT_UNDO,			  // Chessboard::undo calls
+	STAT_UNDO_DEPTH,	  // deepest undo list seen (maximum, not a sum)
+	STAT_PAWN_PROBE,	  // Pawn structure lookups by the engine evaluation
+	STAT_PAWN_HIT,		  // lookups answered by the Pawn hash table
+	STAT_COUNTERS
+};
+
+enum StatTimer
+{
+	TIMER_REDISPLAY,	// Chessboard::redisplay
+	TIMER_BOARD_LAYOUT, // board_layout in the UI
+	TIMER_SELECT,		// Chessboard::select, i.e. handling a click
+	TIMER_TIMERS
+};
+
+const char *stat_counter_names[STAT_COUNTERS] = {"checkmove", "check", "attacked", "checkmate_trial", "move", "undo", "undo_depth", "pawn_probe", "pawn_hit"};
+const char *stat_timer_names[TIMER_TIMERS] = {"redisplay", "board_layout", "select"};
+
+#ifdef CHESS_STATS
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+class ThreadStats // Counters of one thread. Only the owning thread writes them
+{
+public:
+	atomic<uint64_t> count[STAT_COUNTERS];
+	atomic<uint64_t> calls[TIMER_TIMERS];
+	atomic<uint64_t> ns[TIMER_TIMERS]; // total time in nanoseconds
+	ThreadStats *next;
+	ThreadStats();
+};
+
+mutex stats_lock;			   // protects stats_list
+ThreadStats *stats_list = NULL; // blocks of all threads that counted something
+
+ThreadStats::ThreadStats()
+{
+	for (int i = 0; i < STAT_COUNTERS; i++)
+		count[i] = 0;
+	for (int i = 0; i < TIMER_TIMERS; i++)
+		calls[i] = ns[i] = 0;
+	lock_guard<mutex> guard(stats_lock);
+	next = stats_list;
+	stats_list = this;
+}
+
+ThreadStats *thread_stats()
+{
+	static thread_local ThreadStats *block = new ThreadStats;
+	return block;
+}
+
+// Single writer, so a relaxed load and store is enough and avoids a locked instruction
+inline void stat_add(atomic<uint64_t> &c, uint64_t v)
+{
+	c.store(c.load(memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+inline void stat_max(atomic<uint64_t> &c, uint64_t v)
+{
+	if (v > c.load(memory_order_relaxed))
+		c.store(v, memory_order_relaxed);
+}
+
+class ScopedTimer // Adds the time spent in a scope to a StatTimer
+{
+public:
+	int id;
+	chrono::steady_clock::time_point start;
+	ScopedTimer(int t) : id(t), start(chrono::steady_clock::now()) {}
+	~ScopedTimer()
+	{
+		ThreadStats *s = thread_stats();
+		stat_add(s->calls[id], 1);
+		stat_add(s->ns[id], chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+	}
+};
+
+#define STAT_INC(c) stat_add(thread_stats()->count[c], 1)
+#define STAT_MAX(c, v) stat_max(thread_stats()->count[c], v)
+#define STAT_TIMER(t) ScopedTimer stat_timer_##t(t)
+
+// Totals over all threads
+void stats_total(uint64_t count[STAT_COUNTERS], uint64_t calls[TIMER_TIMERS], uint64_t ns[TIMER_TIMERS])
+{
+	memset(count, 0, STAT_COUNTERS * sizeof(uint64_t));
+	memset(calls, 0, TIMER_TIMERS * sizeof(uint64_t));
+	memset(ns, 0, TIMER_TIMERS * sizeof(uint64_t));
+	lock_guard<mutex> guard(stats_lock);
+	for (ThreadStats *s = stats_list; s != NULL; s = s->next)
+	{
+		for (int i = 0; i < STAT_COUNTERS; i++)
+			if (i == STAT_UNDO_DEPTH)
+				count[i] = max(count[i], (uint64_t)s->count[i].load(memory_order_relaxed));
+			else
+				count[i] += s->count[i].load(memory_order_relaxed);
+		for (int i = 0; i < TIMER_TIMERS; i++)
+		{
+			calls[i] += s->calls[i].load(memory_order_relaxed);
+			ns[i] += s->ns[i].load(memory_order_relaxed);
+		}
+	}
+}
+
+// Short summary, one counter or timer per line, for the message box. out must hold 512 characters
+void stats_summary(char *out)
+{
+	uint64_t count[STAT_COUNTERS], calls[TIMER_TIMERS], ns[TIMER_TIMERS];
+	stats_total(count, calls, ns);
+	int n = 0;
+	for (int i = 0; i < STAT_COUNTERS; i++) // two per line, to fit in the message box
+		n += sprintf(out + n, "%s %llu%s", stat_counter_names[i], (unsigned long long)count[i], i % 2 == 0 && i + 1 < STAT_COUNTERS ? "   " : "\n");
+	for (int i = 0; i < TIMER_TIMERS; i++)
+		n += sprintf(out + n, "%s %llu calls %.3f ms avg\n", stat_timer_names[i], (unsigned long long)calls[i],
+					 calls[i] ? ns[i] / 1e6 / calls[i] : 0.0);
+}
+
+// JSON snapshot of the totals
+void stats_json(FILE *fp)
+{
+	uint64_t count[STAT_COUNTERS], calls[TIMER_TIMERS], ns[TIMER_TIMERS];
+	stats_total(count, calls, ns);
+	fprintf(fp, "{\n  \"counters\": {");
+	for (int i = 0; i < STAT_COUNTERS; i++)
+		fprintf(fp, "%s\n    \"%s\": %llu", i ? "," : "", stat_counter_names[i], (unsigned long long)count[i]);
+	fprintf(fp, "\n  },\n  \"timers\": {");
+	for (int i = 0; i < TIMER_TIMERS; i++)
+		fprintf(fp, "%s\n    \"%s\": {\"calls\": %llu, \"ns\": %llu}", i ? "," : "", stat_timer_names[i],
+				(unsigned long long)calls[i], (unsigned long long)ns[i]);
+	fprintf(fp, "\n  }\n}\n");
+}
+
+#else
+
+#define STAT_INC(c) ((void)0)
+#define STAT_MAX(c, v) ((void)0)
+#define STAT_TIMER(t) ((void)0)
+
+void stats_summary(char *out)
+{
+	strcpy(out, "STATISTICS DISABLED\nbuild with make compile STATS=1");
+}
+
+void stats_json(FILE *fp)
+{
+	fprintf(fp, "{\"enabled\": false}\n");
+}
+
+#endif
+
+class StatsDump // Writes the JSON snapshot to $CHESS_STATS_JSON at exit
+{
+public:
+	~StatsDump()
+	{
+		const char *path = getenv("CHESS_STATS_JSON");
+		FILE *fp = path == NULL ? NULL : fopen(path, "w");
+		if (fp == NULL)
+			return;
+		stats_json(fp);
+		fclose(fp);
+	}
+};
+
+StatsDump stats_dump;
+
+#endif
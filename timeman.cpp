@@ -0,0 +1,249 @@
+#ifndef TIMEMAN_CPP
+#define TIMEMAN_CPP
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+using namespace std;
+
+/*	Game clocks, and how the engine spends its time on a move.
+
+	A TimeControl is written "base+inc" in seconds, optionally preceded by a number of moves :
+	"40/300+0" gives 300 seconds for every 40 moves. A GameClock runs the clocks of both players
+	on steady_clock, which is monotonic, so changing the system time does not affect it.
+
+	TimeManager turns the time left into two limits for a move. No iteration of the search starts
+	after the soft limit, which is a share of the time left, longer while the best move changes
+	between iterations and shorter once it has been stable for a few. The search stops at once at
+	the hard limit, which keeps a margin for the time the move takes to reach the clock. Before an
+	iteration starts, its time is predicted from the nodes of the previous ones (their ratio is the
+	branching factor) and the measured nodes per second; an iteration that cannot end before the
+	hard limit is not started. The nodes per second also set how many nodes the search goes
+	between two readings of the clock, so that it reads it about every TIME_CHECK_MS.
+*/
+
+#define TIME_CHECK_MS 0.2	// Time between two readings of the clock by the search
+#define MOVE_OVERHEAD_MS 10	// Kept for the move to reach the clock
+
+class TimeControl
+{
+public:
+	int moves;	// Moves per period, 0 if the base time is for the whole game
+	double base; // Seconds per period
+	double inc;	 // Seconds added after every move
+	TimeControl(double b = 300, double i = 0, int m = 0) : moves(m), base(b), inc(i) {}
+	int parse(const char *s);
+};
+
+int TimeControl::parse(const char *s) // read "[moves/]base[+inc]". Returns 0 if it is invalid
+{
+	int m = 0, n = 0;
+	double b, i = 0;
+	if (sscanf(s, "%d/%n", &m, &n) == 1 && n > 0)
+		s += n;
+	else
+		m = 0;
+	if (sscanf(s, "%lf+%lf", &b, &i) < 1 || b <= 0 || i < 0 || m < 0)
+		return 0;
+	moves = m;
+	base = b;
+	inc = i;
+	return 1;
+}
+
+class GameClock
+{
+public:
+	TimeControl tc;
+	double left[2]; // Seconds left to each player at the start of its move
+	int moves[2];	// Moves made by each player
+	int turn;		// Player whose clock runs
+	int running;
+	int flagged; // Player who ran out of time, -1 if none
+	chrono::steady_clock::time_point since; // Start of the current move
+	GameClock();
+	void start(const TimeControl &t, int player);
+	void stop();
+	int punch();
+	double remaining(int player);
+	int moves_to_go(int player);
+	int check_flag();
+	void text(char *out);
+};
+
+GameClock::GameClock()
+{
+	running = 0;
+	flagged = -1;
+	turn = 0;
+	left[0] = left[1] = 0;
+	moves[0] = moves[1] = 0;
+}
+
+void GameClock::start(const TimeControl &t, int player) // new clocks, running for player
+{
+	tc = t;
+	left[0] = left[1] = t.base;
+	moves[0] = moves[1] = 0;
+	turn = player;
+	flagged = -1;
+	running = 1;
+	since = chrono::steady_clock::now();
+}
+
+void GameClock::stop()
+{
+	if (running)
+		left[turn] = remaining(turn);
+	running = 0;
+}
+
+int GameClock::punch()
+// the player to move has moved : its time is taken, the increment and a new period added, and the
+// clock of the other player starts. Returns 0 if the player had run out of time
+{
+	if (!running)
+		return 1;
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	left[turn] -= chrono::duration<double>(now - since).count();
+	since = now;
+	if (left[turn] <= 0)
+	{
+		flagged = turn;
+		running = 0;
+		return 0;
+	}
+	left[turn] += tc.inc;
+	moves[turn]++;
+	if (tc.moves != 0 && moves[turn] % tc.moves == 0)
+		left[turn] += tc.base;
+	turn = !turn;
+	return 1;
+}
+
+double GameClock::remaining(int player) // seconds left to player, now
+{
+	if (!running || player != turn)
+		return left[player];
+	return left[player] - chrono::duration<double>(chrono::steady_clock::now() - since).count();
+}
+
+int GameClock::moves_to_go(int player) // moves to make before the next period, 0 if there is none
+{
+	return tc.moves == 0 ? 0 : tc.moves - moves[player] % tc.moves;
+}
+
+int GameClock::check_flag() // stop the clock if the player to move has no time left. Returns 1 if so
+{
+	if (running && remaining(turn) <= 0)
+	{
+		left[turn] = 0;
+		flagged = turn;
+		running = 0;
+	}
+	return flagged != -1;
+}
+
+void GameClock::text(char *out) // "WHITE 4:59.3  BLACK 5:00.0", the clock that runs marked. out must hold 64 characters
+{
+	const char *names[2] = {"WHITE", "BLACK"};
+	int n = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		double s = remaining(i);
+		if (s < 0)
+			s = 0;
+		int tenths = (int)(s * 10);
+		n += sprintf(out + n, "%s%s %d:%02d.%d%s", i ? "  " : "", names[i], tenths / 600, tenths / 10 % 60, tenths % 10,
+					 running && turn == i ? " *" : "");
+	}
+	if (flagged != -1)
+		sprintf(out + n, "  %s LOST ON TIME", names[flagged]);
+}
+
+class TimeManager
+{
+public:
+	chrono::steady_clock::time_point start;
+	double soft_ms, hard_ms; // Limits of the current move
+	double nps;				 // Nodes per second measured on the previous moves, 0 if unknown
+	uint64_t nodes[2];		 // Nodes of the last two iterations
+	int stable;				 // Iterations since the best move last changed
+	int best_move;			 // Best move of the last iteration, as x y fx fy digits
+	TimeManager();
+	void plan(double left_ms, double inc_ms, int moves_to_go);
+	double elapsed();
+	uint64_t check_interval();
+	void iteration(uint64_t n, int move);
+	int next_iteration();
+	void done(uint64_t n);
+};
+
+TimeManager::TimeManager()
+{
+	nps = 0;
+	soft_ms = hard_ms = 0;
+}
+
+void TimeManager::plan(double left_ms, double inc_ms, int moves_to_go)
+// set the limits of a move from the time left, the increment and the moves until the next period
+// (0 if none), and start timing it
+{
+	start = chrono::steady_clock::now();
+	double usable = left_ms - MOVE_OVERHEAD_MS;
+	if (usable < 1)
+		usable = 1;
+	int horizon = moves_to_go > 0 ? min(moves_to_go, 30) : 30; // moves the time must last
+	double share = usable / horizon + (horizon > 1 ? inc_ms * 0.75 : 0);
+	hard_ms = min(share * 4, usable * (horizon > 1 ? 0.4 : 0.9));
+	soft_ms = min(share * 0.6, hard_ms);
+	nodes[0] = nodes[1] = 0;
+	stable = 0;
+	best_move = -1;
+}
+
+double TimeManager::elapsed() // milliseconds since plan()
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+uint64_t TimeManager::check_interval() // nodes between two readings of the clock, a power of 2
+{
+	uint64_t n = 1;
+	double nodes = nps > 0 ? nps * TIME_CHECK_MS / 1000 : 64;
+	while (n * 2 <= nodes && n < 1024)
+		n *= 2;
+	return n;
+}
+
+void TimeManager::iteration(uint64_t n, int move) // an iteration of n nodes ended with best move "move"
+{
+	stable = move == best_move ? stable + 1 : 0;
+	best_move = move;
+	nodes[0] = nodes[1];
+	nodes[1] = n;
+}
+
+int TimeManager::next_iteration() // 1 if another iteration should start
+{
+	double t = elapsed();
+	// stable best move : less time, changing : more
+	double soft = soft_ms * (stable >= 3 ? 0.6 : stable == 0 && best_move != -1 ? 1.6 : 1);
+	if (t >= min(soft, hard_ms))
+		return 0;
+	if (nps <= 0 || nodes[0] == 0)
+		return 1;
+	double branching = min(max((double)nodes[1] / nodes[0], 1.5), 10.0);
+	return t + nodes[1] * branching / nps * 1000 < hard_ms;
+}
+
+void TimeManager::done(uint64_t n) // the move is made after n nodes : update the nodes per second
+{
+	double t = elapsed();
+	if (t < 1)
+		return; // too short to measure
+	double measured = n / t * 1000;
+	nps = nps <= 0 ? measured : nps * 0.7 + measured * 0.3;
+}
+
+#endif
@@ -0,0 +1,254 @@
+#include "engine.cpp"
+#include "archive.cpp"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/*	Engine-vs-engine tournament runner.
+
+	Two Engine settings A and B play each opening twice, with colours reversed, on all cores.
+	Games are adjudicated by the runner (checkmate, stalemate, repetition, bare Kings, length, time)
+	and a sequential probability ratio test stops the match as soon as it can tell whether A is at
+	least elo1 stronger than B (H1) or not stronger than elo0 (H0).
+
+	tournament [-a settings] [-b settings] [-openings file] [-tc [moves/]base+inc] [-games n] [-threads n]
+			   [-elo0 e] [-elo1 e] [-alpha a] [-beta b]
+
+	Settings are written as in EngineOptions::parse, e.g. "depth=3,hash=16". Times are in seconds
+	(see TimeControl in timeman.cpp); each engine spends its clock as its TimeManager plans.
+	The opening file has one FEN per line (EPD lines work, only the first fields are read).
+*/
+
+const char *default_openings[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w",
+	"rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w",
+	"rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w",
+	"rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w",
+	"rnbqkb1r/pppp1ppp/4pn2/8/2PP4/8/PP2PPPP/RNBQKBNR w",
+	"rnbqkbnr/pppp1ppp/8/4p3/2P5/8/PP1PPPPP/RNBQKBNR w",
+	"rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w",
+	"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w",
+	"rnbqkbnr/ppp1pppp/8/3p4/8/5N2/PPPPPPPP/RNBQKB1R w",
+	"rnbqkbnr/pp2pppp/2p5/3p4/3PP3/8/PPP2PPP/RNBQKBNR w"};
+
+class Match // Settings and running score of a match between A and B
+{
+public:
+	EngineOptions a, b;
+	vector<string> openings;
+	TimeControl tc;
+	int games, threads;
+	double elo0, elo1, alpha, beta;
+
+	mutex lock; // protects the results below
+	int wins, draws, losses, time_losses; // from the point of view of A
+	uint64_t nodes;
+	double search_seconds;
+	atomic<int> next_game;
+	atomic<int> decided; // 1 when the SPRT accepted a hypothesis
+	Match();
+	double llr();
+	int play(int game, Engine &white, Engine &black);
+	void worker();
+};
+
+Match::Match()
+{
+	tc = TimeControl(10, 0.1);
+	games = 1000;
+	threads = thread::hardware_concurrency();
+	if (threads < 1)
+		threads = 1;
+	elo0 = 0;
+	elo1 = 10;
+	alpha = beta = 0.05;
+	wins = draws = losses = time_losses = 0;
+	nodes = 0;
+	search_seconds = 0;
+	next_game = 0;
+	decided = 0;
+}
+
+// Expected score of a player stronger by "elo"
+double elo_score(double elo)
+{
+	return 1 / (1 + pow(10, -elo / 400));
+}
+
+double score_elo(double s)
+{
+	if (s <= 0)
+		return -INFINITY;
+	if (s >= 1)
+		return INFINITY;
+	return -400 * log10(1 / s - 1);
+}
+
+double Match::llr() // log-likelihood ratio of H1 against H0 (normal approximation of the trinomial model)
+{
+	int n = wins + draws + losses;
+	if (n == 0 || wins + losses == 0)
+		return 0;
+	double w = (double)wins / n, d = (double)draws / n;
+	double s = w + d / 2;
+	double var = w + d / 4 - s * s; // variance of the score of one game
+	if (var <= 0)
+		return 0;
+	double s0 = elo_score(elo0), s1 = elo_score(elo1);
+	return n * (s1 - s0) * (2 * s - s0 - s1) / (2 * var);
+}
+
+int Match::play(int game, Engine &white, Engine &black)
+// play one game and return its result (RESULT_WHITE, ...). Loss on time is reported as a loss
+{
+	Chessboard c;
+	c.setup(openings[game / 2 % openings.size()].c_str());
+	Engine *engine[2] = {&white, &black};
+	GameClock clock;
+	vector<uint64_t> keys;
+	white.clear();
+	black.clear();
+	clock.start(tc, c.turn);
+	for (int ply = 0;; ply++)
+	{
+		keys.push_back(c.key());
+		int result = adjudicate(c, keys, ply);
+		if (result != RESULT_UNKNOWN)
+			return result;
+
+		int side = c.turn, score, depth;
+		Engine *e = engine[side];
+		e->history = keys;
+		e->history.pop_back(); // the search adds the root position itself
+		uint64_t before = e->nodes;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		Move m = e->think(c, clock, score, depth);
+		double used = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		{
+			lock_guard<mutex> guard(lock);
+			nodes += e->nodes - before;
+			search_seconds += used;
+		}
+		if (!clock.punch())
+		{
+			lock_guard<mutex> guard(lock);
+			time_losses++;
+			return side == 0 ? RESULT_BLACK : RESULT_WHITE;
+		}
+		c.make(m);
+	}
+}
+
+void Match::worker()
+{
+	Engine ea(a), eb(b);
+	for (;;)
+	{
+		int game = next_game++;
+		if (game >= games || decided)
+			return;
+		int a_white = game % 2 == 0; // every opening is played once with each colour
+		int result = a_white ? play(game, ea, eb) : play(game, eb, ea);
+		if (decided)
+			return; // the match ended during the game
+		lock_guard<mutex> guard(lock);
+		if (result == RESULT_DRAW)
+			draws++;
+		else if ((result == RESULT_WHITE) == a_white)
+			wins++;
+		else
+			losses++;
+		double l = llr(), lower = log(beta / (1 - alpha)), upper = log((1 - beta) / alpha);
+		int n = wins + draws + losses;
+		cout << "game " << n << " +" << wins << " =" << draws << " -" << losses << " llr " << l << " (" << lower << ", " << upper << ")" << endl;
+		if (l <= lower || l >= upper)
+			decided = 1;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Match match;
+	const char *openings_path = NULL;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		string o = argv[i];
+		const char *v = argv[i + 1];
+		int ok = 1;
+		if (o == "-a")
+			ok = match.a.parse(v);
+		else if (o == "-b")
+			ok = match.b.parse(v);
+		else if (o == "-openings")
+			openings_path = v;
+		else if (o == "-tc")
+			ok = match.tc.parse(v);
+		else if (o == "-games")
+			match.games = atoi(v);
+		else if (o == "-threads")
+			match.threads = max(1, atoi(v));
+		else if (o == "-elo0")
+			match.elo0 = atof(v);
+		else if (o == "-elo1")
+			match.elo1 = atof(v);
+		else if (o == "-alpha")
+			match.alpha = atof(v);
+		else if (o == "-beta")
+			match.beta = atof(v);
+		else
+			ok = 0;
+		if (!ok)
+		{
+			cerr << "invalid option " << o << " " << v << endl;
+			return 1;
+		}
+	}
+
+	if (openings_path != NULL)
+	{
+		FILE *fp = fopen(openings_path, "r");
+		char line[256];
+		while (fp != NULL && fgets(line, sizeof(line), fp) != NULL)
+			if (line[0] != '#' && line[0] != '\n')
+				match.openings.push_back(line);
+		if (fp != NULL)
+			fclose(fp);
+	}
+	else
+		for (int i = 0; i < sizeof(default_openings) / sizeof(default_openings[0]); i++)
+			match.openings.push_back(default_openings[i]);
+	for (int i = 0; i < match.openings.size(); i++)
+	{
+		Chessboard c;
+		if (!c.setup(match.openings[i].c_str()))
+		{
+			cerr << "invalid opening: " << match.openings[i] << endl;
+			return 1;
+		}
+	}
+	if (match.openings.size() == 0)
+	{
+		cerr << "no openings" << endl;
+		return 1;
+	}
+
+	vector<thread> workers;
+	for (int i = 0; i < match.threads; i++)
+		workers.push_back(thread(&Match::worker, &match));
+	for (int i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	int n = match.wins + match.draws + match.losses;
+	double s = n ? (match.wins + match.draws / 2.0) / n : 0.5;
+	double var = n ? ((double)match.wins / n + match.draws / 4.0 / n - s * s) : 0;
+	double margin = n ? 1.96 * sqrt(max(var, 0.0) / n) : 0;
+	double l = match.llr();
+	cout << endl
+		 << "games " << n << " +" << match.wins << " =" << match.draws << " -" << match.losses
+		 << " (" << match.time_losses << " lost on time)" << endl;
+	cout << "elo " << score_elo(s) << " [" << score_elo(s - margin) << ", " << score_elo(s + margin) << "]" << endl;
+	cout << "sprt elo0 " << match.elo0 << " elo1 " << match.elo1 << " llr " << l << ": "
+		 << (l >= log((1 - match.beta) / match.alpha) ? "H1 accepted" : l <= log(match.beta / (1 - match.alpha)) ? "H0 accepted" : "inconclusive") << endl;
+	cout << "nodes/s " << (match.search_seconds > 0 ? match.nodes / match.search_seconds : 0) << endl;
+	return 0;
+}
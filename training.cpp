@@ -0,0 +1,23 @@
+#ifndef TRAINING_CPP
+#define TRAINING_CPP
+
+#include "chess.cpp"
+#include "archive.cpp"
+
+/*	Training data : positions with the score of a search and the result of their game, written by
+	datagen and read by tune as fixed-size records, one after the other, with no header.
+*/
+
+struct TrainingRecord // 32 bytes
+{
+	PackedBoard board; // includes the player to move
+	int16_t score;	   // search score for the player to move, in centipawns
+	uint8_t result;	   // RESULT_WHITE, RESULT_BLACK or RESULT_DRAW
+	uint8_t turn;	   // player to move, duplicated from board for convenience
+	uint16_t ply;
+	uint16_t reserved;
+};
+
+static_assert(sizeof(TrainingRecord) == 32, "TrainingRecord is a file format");
+
+#endif
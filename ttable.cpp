@@ -0,0 +1,231 @@
+#ifndef TTABLE_CPP
+#define TTABLE_CPP
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+using namespace std;
+
+/*	Transposition table of the engine.
+
+	The table is private to an Engine, or placed in a named POSIX shared-memory segment (shm_open)
+	so that every engine process of the host which names the same segment shares search results.
+	The segment starts with a TTHeader; the process that creates it (O_EXCL) sizes and initialises
+	it, the others wait until it is ready, check its version and map the size it records. It is never removed by the engine, so a process started
+	later finds the work of the earlier ones (rm /dev/shm/<name> to start over).
+
+	A slot is two 64-bit words, the data and the key xor the data, read and written without locks.
+	When two processes write the same slot at once, a reader may see the words of different
+	entries; the key check then fails and the slot is a miss. Keys are also mixed with a salt from
+	the engine settings, so engines that evaluate differently do not use each other's scores.
+	Huge pages are asked for with madvise, which the kernel may ignore.
+*/
+
+struct TTEntry
+{
+	uint64_t key;
+	int16_t score;
+	uint8_t depth, flag;
+	uint8_t x, y, fx, fy; // Best move
+};
+
+struct TTSlot
+{
+	atomic<uint64_t> check; // key ^ data
+	atomic<uint64_t> data;	// the 8 bytes of a TTEntry after its key
+};
+
+#define TT_MAGIC "CGT1"
+#define TT_VERSION 1
+#define TT_HEADER 64 // Bytes before the slots, so that they are aligned on cache lines
+
+struct TTHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t slot_size;		// sizeof(TTSlot)
+	atomic<uint32_t> state; // 2 once the creator has written the header
+	uint64_t slots;			// Number of slots, a power of 2
+};
+
+class TTable
+{
+public:
+	TTSlot *slots;
+	uint64_t mask; // Number of slots - 1
+	uint64_t salt; // Mixed with every key
+	int shared;	   // 1 if the table is in a shared-memory segment
+	void *map;
+	size_t map_size;
+	TTable();
+	~TTable();
+	int create(int mb);
+	int attach(const char *name, int mb);
+	void release();
+	void clear();
+	int probe(uint64_t key, TTEntry &e);
+	void store(const TTEntry &e);
+
+private:
+	TTable(const TTable &); // The mapping is owned by the TTable
+	TTable &operator=(const TTable &);
+};
+
+static_assert(sizeof(TTEntry) == 16, "TTEntry must be a key and 8 bytes of data");
+static_assert(sizeof(TTHeader) <= TT_HEADER, "TTHeader too large");
+static_assert(atomic<uint64_t>::is_always_lock_free, "lock-free 64-bit atomics are needed to share the table");
+
+TTable::TTable()
+{
+	slots = NULL;
+	mask = 0;
+	salt = 0;
+	shared = 0;
+	map = NULL;
+	map_size = 0;
+}
+
+TTable::~TTable()
+{
+	release();
+}
+
+void TTable::release() // unmap the table. A shared segment stays for the other processes
+{
+	if (map != NULL)
+		munmap(map, map_size);
+	map = NULL;
+	slots = NULL;
+	mask = 0;
+	shared = 0;
+}
+
+uint64_t tt_slots(int mb) // largest power of 2 of slots that fits in mb megabytes (at least 1)
+{
+	uint64_t n = 1;
+	while (n * 2 * sizeof(TTSlot) <= (uint64_t)mb << 20)
+		n *= 2;
+	return n;
+}
+
+int TTable::create(int mb) // allocate a private table of at most mb megabytes. Returns 0 on failure
+{
+	release();
+	uint64_t n = tt_slots(mb);
+	map_size = n * sizeof(TTSlot);
+	map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+	{
+		map = NULL;
+		return 0;
+	}
+	madvise(map, map_size, MADV_HUGEPAGE);
+	slots = (TTSlot *)map; // anonymous memory is zero, so every slot is empty
+	mask = n - 1;
+	return 1;
+}
+
+int TTable::attach(const char *name, int mb)
+// use the shared-memory segment "name" (e.g. "/chess-tt"), creating it with mb megabytes of slots if it
+// does not exist; an existing segment keeps the size it was created with. Returns 0 if it cannot be
+// opened, was made by an incompatible version or is not ready within one second
+{
+	release();
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1) // this process created the segment, and alone sizes and initialises it
+	{
+		uint64_t n = tt_slots(mb);
+		map_size = TT_HEADER + n * sizeof(TTSlot);
+		if (ftruncate(fd, map_size) == 0)
+			map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (map == MAP_FAILED || map == NULL)
+		{
+			map = NULL;
+			shm_unlink(name); // do not leave an empty segment for the others to wait on
+			return 0;
+		}
+		TTHeader *h = (TTHeader *)map;
+		memcpy(h->magic, TT_MAGIC, 4);
+		h->version = TT_VERSION;
+		h->slot_size = sizeof(TTSlot);
+		h->slots = n;
+		h->state = 2;
+	}
+	else
+	{
+		if (errno != EEXIST || (fd = shm_open(name, O_RDWR, 0600)) == -1)
+			return 0;
+		// map the header, once the creator has sized the segment, and wait for it to be ready
+		TTHeader *h = NULL;
+		struct stat st;
+		for (int i = 0; i < 1000; i++)
+		{
+			if (h == NULL && fstat(fd, &st) == 0 && st.st_size >= TT_HEADER)
+			{
+				h = (TTHeader *)mmap(NULL, TT_HEADER, PROT_READ, MAP_SHARED, fd, 0);
+				if (h == MAP_FAILED)
+					h = NULL;
+			}
+			if (h != NULL && h->state == 2)
+				break;
+			this_thread::sleep_for(chrono::milliseconds(1));
+		}
+		int ok = h != NULL && h->state == 2 && memcmp(h->magic, TT_MAGIC, 4) == 0 && h->version == TT_VERSION &&
+				 h->slot_size == sizeof(TTSlot) && h->slots != 0 && (h->slots & (h->slots - 1)) == 0 &&
+				 fstat(fd, &st) == 0 && TT_HEADER + h->slots * sizeof(TTSlot) <= (uint64_t)st.st_size;
+		if (ok) // the size recorded by the creator, whatever mb is
+		{
+			map_size = TT_HEADER + h->slots * sizeof(TTSlot);
+			map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (map == MAP_FAILED)
+				map = NULL;
+		}
+		if (h != NULL)
+			munmap(h, TT_HEADER);
+		close(fd);
+		if (map == NULL)
+			return 0;
+	}
+	madvise(map, map_size, MADV_HUGEPAGE);
+	slots = (TTSlot *)((char *)map + TT_HEADER);
+	mask = ((TTHeader *)map)->slots - 1;
+	shared = 1;
+	return 1;
+}
+
+void TTable::clear() // empty a private table. A shared one is kept, as other processes use it
+{
+	if (slots != NULL && !shared)
+		memset((void *)slots, 0, (mask + 1) * sizeof(TTSlot));
+}
+
+int TTable::probe(uint64_t key, TTEntry &e) // copy the entry of the position into e. Returns 0 if there is none
+{
+	key ^= salt;
+	TTSlot &s = slots[key & mask];
+	uint64_t data = s.data.load(memory_order_relaxed);
+	if ((s.check.load(memory_order_relaxed) ^ data) != key)
+		return 0;
+	e.key = key ^ salt;
+	memcpy(&e.score, &data, 8);
+	return 1;
+}
+
+void TTable::store(const TTEntry &e)
+{
+	uint64_t key = e.key ^ salt, data;
+	memcpy(&data, &e.score, 8);
+	TTSlot &s = slots[key & mask];
+	s.data.store(data, memory_order_relaxed);
+	s.check.store(key ^ data, memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "engine.cpp"
+#include "training.cpp"
+#include <math.h>
+#include <thread>
+
+/*	Evaluation tuning (Texel's method).
+
+		tune data [-out weights.h] [-threads n] [-iterations n] [-rate r] [-lambda l] [-max n]
+
+	The positions of training data written by datagen are loaded and Engine::evaluate counts their
+	FEATURES once, on all threads; each position is then kept as a 22-byte TuningPosition. The score
+	of a position is the weighted sum of its features and its expected result for white is
+	sigmoid(K * score). K is fitted to the current weights first, then all the weights are fitted by
+	gradient descent (Adam, -rate centipawns per step at most, -iterations steps) on the logistic
+	loss. The target is the game result, or with -lambda l, l * sigmoid(K * search score) +
+	(1 - l) * result : the search scores of datagen are less noisy than the results of few games.
+	Each step goes through all the positions, split between the threads.
+
+	The weights found are written in the format of weights.h (to standard output without -out).
+	Progress and the weights as engine settings, to compare them with the current ones in a
+	tournament, go to standard error.
+*/
+
+struct TuningPosition // 22 bytes
+{
+	int8_t features[FEATURES]; // see Engine::evaluate
+	uint8_t result;			   // half points won by white : 0, 1 or 2
+	uint8_t valid;
+	int16_t score; // search score for white
+};
+
+class Tuner
+{
+public:
+	vector<TuningPosition> positions;
+	double weight[FEATURES];
+	double k;
+	double lambda; // weight of the search score in the target
+	int threads;
+	Tuner(int n);
+	int load(const char *path, size_t limit);
+	double loss(double *gradient);
+	void fit_k();
+	void fit(int iterations, double rate);
+	void write(FILE *out, const char *source);
+};
+
+Tuner::Tuner(int n)
+{
+	EngineOptions o;
+	for (int i = 0; i < FEATURES; i++)
+		weight[i] = i < 6 ? o.value[i] : o.weight[i - 6];
+	k = 1;
+	lambda = 0;
+	threads = n;
+}
+
+int Tuner::load(const char *path, size_t limit) // read at most limit records. Returns 0 if the file cannot be read
+{
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL)
+		return 0;
+	vector<TrainingRecord> records;
+	TrainingRecord r;
+	while (records.size() < limit && fread(&r, sizeof(r), 1, fp) == 1)
+		records.push_back(r);
+	fclose(fp);
+
+	positions.resize(records.size());
+	vector<thread> pool;
+	for (int t = 0; t < threads; t++)
+		pool.push_back(thread([this, &records, t]() {
+			EngineOptions o;
+			o.hash_mb = 1;
+			Engine e(o);
+			Chessboard c;
+			int n[FEATURES];
+			for (size_t i = t; i < records.size(); i += threads)
+			{
+				TuningPosition &p = positions[i];
+				p.valid = 0;
+				if (records[i].result < RESULT_WHITE || records[i].result > RESULT_DRAW || !c.unpack(records[i].board))
+					continue;
+				e.evaluate(c, n);
+				p.valid = 1;
+				for (int j = 0; j < FEATURES; j++)
+				{
+					if (n[j] < -127 || n[j] > 127)
+						p.valid = 0;
+					p.features[j] = n[j];
+				}
+				p.result = records[i].result == RESULT_WHITE ? 2 : records[i].result == RESULT_DRAW ? 1 : 0;
+				p.score = c.turn == 0 ? records[i].score : -records[i].score;
+			}
+		}));
+	for (int t = 0; t < threads; t++)
+		pool[t].join();
+	size_t kept = 0;
+	for (size_t i = 0; i < positions.size(); i++)
+		if (positions[i].valid)
+			positions[kept++] = positions[i];
+	positions.resize(kept);
+	return 1;
+}
+
+double Tuner::loss(double *gradient)
+// mean logistic loss of the positions with the current weights, and its gradient if not NULL
+{
+	vector<double> sums(threads * (FEATURES + 1), 0.0);
+	double c = k * log(10.0) / 400; // scores are in centipawns, K = 1 gives 1 : 10 odds for 400
+	vector<thread> pool;
+	for (int t = 0; t < threads; t++)
+		pool.push_back(thread([this, &sums, c, gradient, t]() {
+			double *sum = &sums[t * (FEATURES + 1)];
+			size_t begin = positions.size() * t / threads, end = positions.size() * (t + 1) / threads;
+			for (size_t i = begin; i < end; i++)
+			{
+				const TuningPosition &p = positions[i];
+				double score = 0, r = p.result / 2.0;
+				if (lambda != 0)
+					r = lambda / (1 + exp(-c * p.score)) + (1 - lambda) * r;
+				for (int j = 0; j < FEATURES; j++)
+					score += p.features[j] * weight[j];
+				double s = 1 / (1 + exp(-c * score));
+				s = min(max(s, 1e-12), 1 - 1e-12);
+				sum[FEATURES] -= r * log(s) + (1 - r) * log(1 - s);
+				if (gradient != NULL)
+					for (int j = 0; j < FEATURES; j++)
+						sum[j] += (s - r) * c * p.features[j];
+			}
+		}));
+	for (int t = 0; t < threads; t++)
+		pool[t].join();
+	double total = 0, n = max((size_t)1, positions.size());
+	for (int j = 0; j < FEATURES; j++)
+		if (gradient != NULL)
+			gradient[j] = 0;
+	for (int t = 0; t < threads; t++)
+	{
+		for (int j = 0; j < FEATURES && gradient != NULL; j++)
+			gradient[j] += sums[t * (FEATURES + 1) + j] / n;
+		total += sums[t * (FEATURES + 1) + FEATURES];
+	}
+	return total / n;
+}
+
+void Tuner::fit_k() // the K giving the lowest loss with the current weights (golden section search)
+{
+	double a = 0.05, b = 5, g = (sqrt(5.0) - 1) / 2;
+	for (int i = 0; i < 40; i++)
+	{
+		double k1 = b - g * (b - a), k2 = a + g * (b - a);
+		k = k1;
+		double l1 = loss(NULL);
+		k = k2;
+		double l2 = loss(NULL);
+		if (l1 < l2)
+			b = k2;
+		else
+			a = k1;
+	}
+	k = (a + b) / 2;
+}
+
+void Tuner::fit(int iterations, double rate) // Adam steps on all weights but the King's
+{
+	double g[FEATURES], m[FEATURES] = {}, v[FEATURES] = {};
+	const double b1 = 0.9, b2 = 0.999;
+	for (int it = 1; it <= iterations; it++)
+	{
+		double l = loss(g);
+		if (it == 1 || it % 50 == 0)
+			cerr << "iteration " << it << " loss " << l << endl;
+		for (int j = 1; j < FEATURES; j++)
+		{
+			m[j] = b1 * m[j] + (1 - b1) * g[j];
+			v[j] = b2 * v[j] + (1 - b2) * g[j] * g[j];
+			double mh = m[j] / (1 - pow(b1, it)), vh = v[j] / (1 - pow(b2, it));
+			weight[j] -= rate * mh / (sqrt(vh) + 1e-12);
+		}
+	}
+}
+
+void Tuner::write(FILE *out, const char *source) // the weights, rounded, in the format of weights.h
+{
+	const char *pieces[6] = {NULL, "QUEEN", "ROOK", "BISHOP", "KNIGHT", "PAWN"};
+	fprintf(out, "// Evaluation weights of the engine in centipawns (see the TERM_ names in engine.cpp).\n");
+	fprintf(out, "// Generated by tune from %s (%zu positions, K = %.3f, loss %.6f).\n\n", source, positions.size(), k, loss(NULL));
+	for (int j = 1; j < 6 + TERM_PAWN_PASSED; j++)
+	{
+		char name[32];
+		strcpy(name, j < 6 ? pieces[j] : term_names[j - 6]);
+		for (int i = 0; name[i] != '\0'; i++)
+			name[i] = toupper(name[i]);
+		fprintf(out, "#define WEIGHT_%s %d\n", name, (int)lround(weight[j]));
+	}
+	fprintf(out, "#define WEIGHT_PAWN_PASSED");
+	for (int j = 6 + TERM_PAWN_PASSED; j < FEATURES; j++)
+		fprintf(out, "%s %d", j == 6 + TERM_PAWN_PASSED ? "" : ",", (int)lround(weight[j]));
+	fprintf(out, "\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *out = NULL;
+	int threads = thread::hardware_concurrency(), iterations = 1000;
+	double rate = 1, lambda = 0;
+	size_t limit = SIZE_MAX;
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-out") == 0)
+			out = argv[i + 1];
+		else if (strcmp(argv[i], "-threads") == 0)
+			threads = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-iterations") == 0)
+			iterations = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-rate") == 0)
+			rate = atof(argv[i + 1]);
+		else if (strcmp(argv[i], "-lambda") == 0)
+			lambda = atof(argv[i + 1]);
+		else if (strcmp(argv[i], "-max") == 0)
+			limit = atoll(argv[i + 1]);
+		else
+			argc = 0;
+	}
+	if (argc < 2 || argc % 2 != 0)
+	{
+		cerr << "usage: " << argv[0] << " data [-out weights.h] [-threads n] [-iterations n] [-rate r] [-lambda l] [-max n]" << endl;
+		return 1;
+	}
+	Tuner tuner(max(threads, 1));
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if (!tuner.load(argv[1], limit) || tuner.positions.size() == 0)
+	{
+		cerr << "no positions in " << argv[1] << endl;
+		return 1;
+	}
+	cerr << tuner.positions.size() << " positions loaded in " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+	tuner.fit_k(); // on the results only
+	tuner.lambda = lambda;
+	cerr << "K " << tuner.k << " loss " << tuner.loss(NULL) << endl;
+	tuner.fit(iterations, rate);
+	cerr << "done in " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+
+	// the weights as engine settings, e.g. for tournament -a
+	const char *pieces[6] = {NULL, "q", "r", "b", "n", "p"};
+	for (int j = 1; j < FEATURES; j++)
+		cerr << (j == 1 ? "" : ",") << (j < 6 ? pieces[j] : term_names[j - 6]) << "=" << lround(tuner.weight[j]);
+	cerr << endl;
+
+	FILE *fp = out == NULL ? stdout : fopen(out, "w");
+	if (fp == NULL)
+	{
+		cerr << "could not write " << out << endl;
+		return 1;
+	}
+	tuner.write(fp, argv[1]);
+	if (fp != stdout)
+		fclose(fp);
+	return 0;
+}
@@ -0,0 +1,252 @@
+#ifndef VARIATION_CPP
+#define VARIATION_CPP
+
+#include "chess.cpp"
+
+/*	Tree of the variations explored on a Chessboard.
+
+	Every node is a move and its children are the moves tried after it. A move played again from
+	the same node reuses its child, so lines share their common start and the tree only grows with
+	moves that were not played there before. Every node keeps its position key; the root, the
+	first node of every variation but the main one and the nodes every SNAPSHOT_PLIES plies also keep
+	the packed position, so any node is at most SNAPSHOT_PLIES - 1 moves from a kept position.
+
+	go() takes the moves back to the common ancestor of the two nodes and plays the others, or
+	unpacks the nearest kept position above the target when that is shorter. The Chessboard undo
+	list then starts at that position ("base"), so the moves of a line are read from the tree.
+	jump() goes to any ply of the current line in about the same time, however long the game.
+*/
+
+#define UNPACK_COST 4     // Unpacking a position costs about as much as this many moves
+#define SNAPSHOT_PLIES 16 // Plies between the kept positions of a line
+
+class VariationNode
+{
+public:
+	Move move;		 // Move leading to the node, unused for the root
+	int parent;		 // -1 for the root
+	int first, next; // First child and next sibling, -1 if none
+	int last;		 // Child visited last, -1 if none
+	int depth;		 // Plies from the root
+	int packed;		 // Index of the kept position in VariationTree::positions, -1 if none
+	uint64_t key;
+	int score, score_depth; // Engine result for the player to move, score_depth is -1 if none
+	Move best;
+};
+
+class VariationTree
+{
+public:
+	vector<VariationNode> nodes;
+	vector<PackedBoard> positions;
+	int current; // Node of the position on the Chessboard
+	int base;	 // Node of the position the Chessboard undo list starts from
+	VariationTree();
+	void reset(Chessboard &c);
+	int child(int node, Move m);
+	int add(int node, Move m, Chessboard &c);
+	void record(Chessboard &c);
+	int go(Chessboard &c, int target);
+	int back(Chessboard &c);
+	int forward(Chessboard &c);
+	int sibling(Chessboard &c);
+	int ply(int n);
+	int jump(Chessboard &c, int n);
+	void line(int node, vector<Move> &moves);
+	void annotate(int node, int score, int depth, Move best);
+};
+
+VariationTree::VariationTree()
+{
+	current = base = -1;
+}
+
+void VariationTree::reset(Chessboard &c)
+// start a new tree from the game on c : the root is the start of its undo list and the moves
+// played so far are the main line
+{
+	vector<Move> moves;
+	c.game_moves(moves);
+	for (int i = 0; i < moves.size(); i++)
+		c.unmake();
+	nodes.clear();
+	positions.clear();
+	VariationNode root;
+	root.parent = root.first = root.next = root.last = -1;
+	root.depth = 0;
+	root.packed = 0;
+	root.key = c.key();
+	root.score_depth = -1;
+	nodes.push_back(root);
+	positions.resize(1);
+	c.pack(positions[0]);
+	current = base = 0;
+	for (int i = 0; i < moves.size(); i++)
+	{
+		c.make(moves[i]);
+		record(c);
+	}
+}
+
+int VariationTree::child(int node, Move m) // child of node for move m, -1 if it was never played
+{
+	for (int i = nodes[node].first; i != -1; i = nodes[i].next)
+	{
+		Move &n = nodes[i].move;
+		if (n.x == m.x && n.y == m.y && n.fx == m.fx && n.fy == m.fy)
+			return i;
+	}
+	return -1;
+}
+
+int VariationTree::add(int node, Move m, Chessboard &c)
+// add move m, played from node, as a child of node. c must hold the position reached
+{
+	VariationNode n;
+	n.move = m;
+	n.parent = node;
+	n.first = n.next = n.last = -1;
+	n.depth = nodes[node].depth + 1;
+	n.packed = -1;
+	n.key = c.key();
+	n.score_depth = -1;
+	int i = nodes.size();
+	int keep = n.depth % SNAPSHOT_PLIES == 0;
+	if (nodes[node].first == -1)
+		nodes[node].first = i;
+	else
+	{
+		// a new variation : keep its first position, to go there without replaying the line before
+		int j = nodes[node].first;
+		while (nodes[j].next != -1)
+			j = nodes[j].next;
+		nodes[j].next = i;
+		keep = 1;
+	}
+	if (keep)
+	{
+		n.packed = positions.size();
+		positions.resize(positions.size() + 1);
+		c.pack(positions.back());
+	}
+	nodes.push_back(n);
+	return i;
+}
+
+void VariationTree::record(Chessboard &c) // follow the move just played on c, adding it to the tree if it is new
+{
+	UndoObj temp = c.prev_list.back();
+	if (temp.x == temp.fx && temp.y == temp.fy) // Pawn promotion, the move is the entry before
+		temp = c.prev_list[c.prev_list.size() - 2];
+	Move m(temp.x, temp.y, temp.fx, temp.fy);
+	int i = child(current, m);
+	if (i == -1)
+		i = add(current, m, c);
+	nodes[current].last = i;
+	current = i;
+}
+
+int VariationTree::go(Chessboard &c, int target)
+// set up the position of node target on c. Returns 0 if target is not a node
+{
+	if (target < 0 || target >= nodes.size())
+		return 0;
+
+	// moves back to the common ancestor, then forward to target
+	int a = current, b = target, up = 0, down = 0;
+	while (nodes[a].depth > nodes[b].depth)
+		a = nodes[a].parent, up++;
+	while (nodes[b].depth > nodes[a].depth)
+		b = nodes[b].parent, down++;
+	while (a != b)
+		a = nodes[a].parent, b = nodes[b].parent, up++, down++;
+	// the moves back must still be on the undo list, so the common ancestor must be below base
+	int k = a;
+	while (nodes[k].depth > nodes[base].depth)
+		k = nodes[k].parent;
+	int reachable = k == base;
+
+	// or the nearest kept position above target
+	int kept = target;
+	while (nodes[kept].packed == -1)
+		kept = nodes[kept].parent;
+
+	if (!reachable || UNPACK_COST + nodes[target].depth - nodes[kept].depth < up + down)
+	{
+		c.unpack(positions[nodes[kept].packed]);
+		base = current = kept;
+	}
+	else
+	{
+		for (int i = 0; i < up; i++)
+			c.unmake();
+		current = a;
+	}
+
+	vector<int> path; // nodes from target up to current
+	for (int i = target; i != current; i = nodes[i].parent)
+		path.push_back(i);
+	for (int i = path.size() - 1; i >= 0; i--)
+	{
+		c.make(nodes[path[i]].move);
+		nodes[current].last = path[i];
+		current = path[i];
+	}
+	return 1;
+}
+
+int VariationTree::back(Chessboard &c) // go to the parent of the current node. Returns 0 at the root
+{
+	return nodes[current].parent != -1 && go(c, nodes[current].parent);
+}
+
+int VariationTree::forward(Chessboard &c) // go to the child visited last. Returns 0 if there is none
+{
+	return nodes[current].last != -1 && go(c, nodes[current].last);
+}
+
+int VariationTree::sibling(Chessboard &c) // go to the next variation of the current move, the first after the last
+{
+	int p = nodes[current].parent;
+	if (p == -1 || (nodes[current].next == -1 && nodes[p].first == current))
+		return 0;
+	return go(c, nodes[current].next != -1 ? nodes[current].next : nodes[p].first);
+}
+
+int VariationTree::ply(int n)
+// node at depth n of the current line, which goes on after the current node with the children
+// visited last. The last node of the line if it is shorter
+{
+	int i = current;
+	while (nodes[i].depth > n)
+		i = nodes[i].parent;
+	while (nodes[i].depth < n && nodes[i].last != -1)
+		i = nodes[i].last;
+	return i;
+}
+
+int VariationTree::jump(Chessboard &c, int n) // go to ply n of the current line (see ply()). Returns 0 if already there
+{
+	int target = ply(n < 0 ? 0 : n);
+	return target != current && go(c, target);
+}
+
+void VariationTree::line(int node, vector<Move> &moves) // moves from the root to node
+{
+	moves.clear();
+	for (; nodes[node].parent != -1; node = nodes[node].parent)
+		moves.push_back(nodes[node].move);
+	reverse(moves.begin(), moves.end());
+}
+
+void VariationTree::annotate(int node, int score, int depth, Move best) // keep the deepest engine result of a node
+{
+	VariationNode &n = nodes[node];
+	if (depth < n.score_depth)
+		return;
+	n.score = score;
+	n.score_depth = depth;
+	n.best = best;
+}
+
+#endif
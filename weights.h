@@ -0,0 +1,15 @@
+// Evaluation weights of the engine in centipawns (see the TERM_ names in engine.cpp).
+// Generated by tune, or edited by hand : ./tune <training data> -out weights.h
+
+#define WEIGHT_QUEEN 900
+#define WEIGHT_ROOK 500
+#define WEIGHT_BISHOP 330
+#define WEIGHT_KNIGHT 320
+#define WEIGHT_PAWN 100
+#define WEIGHT_CENTRE 1
+#define WEIGHT_PAWN_ADVANCE 4
+#define WEIGHT_PAWN_DOUBLED 12
+#define WEIGHT_PAWN_ISOLATED 10
+#define WEIGHT_PAWN_BACKWARD 8
+#define WEIGHT_KING_SHELTER 8
+#define WEIGHT_PAWN_PASSED 5, 10, 20, 35, 60, 100